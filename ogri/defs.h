@@ -16,6 +16,7 @@ extern int yylineno;
 int main(int, char**);
 int yylex(void);
 void comment(void);
+char* unescape(const char*);
 int yyparse(void);
 void yyerror(char*);
 
@@ -5,6 +5,7 @@
 #define __AST_H__
 
 #include <stdbool.h>
+#include "Environment.h"
 
 typedef enum {
     AST_STATEMENTS,
@@ -18,9 +19,11 @@ typedef enum {
     AST_ASSIGN,
     AST_ARRAY_ASSIGN,
     AST_RETURN,
+    AST_YIELD,
     AST_BREAK,
     AST_CONTINUE,
     AST_FUNC_CALL,
+    AST_RECORD_DEF,
 
     AST_BLOCK,
     // expressions
@@ -37,14 +40,64 @@ typedef enum {
     AST_IDENTIFIER_LIST,
     AST_ARRAY_ACCESS,
     AST_SLICE,
-    AST_RANGE
+    AST_RANGE,
+    AST_MAP,
+    AST_FIELD,
+    // optimizer
+    AST_BOOL,
+    AST_CONSTANT,
+    AST_CACHED,
+    AST_UNBOXED,
+    AST_INLINE,
+    AST_ARGUMENT,
+    AST_SWITCH
 } AstKind;
 
+typedef enum {
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_MOD,
+    OP_EQ,
+    OP_NE,
+    OP_LT,
+    OP_GT,
+    OP_LE,
+    OP_GE,
+    OP_AND,
+    OP_OR,
+    OP_NOT,
+    OP_OTHER
+} Operator;
+
+// 型推論で求めた式の型
+typedef enum {
+    TYPE_ANY,       // 実行するまで分からない
+    TYPE_INTEGER,
+    TYPE_FLOAT,
+    TYPE_BOOL,
+    TYPE_STRING,
+    TYPE_LIST
+} StaticType;
+
 typedef struct Ast Ast;
+typedef struct object Object;
+typedef struct jit_code JitCode;
+typedef struct closure Closure;
+typedef struct shape Shape;
+
+// 分岐表の要素
+typedef struct switch_case {
+    long integer;
+    const char* string;     // 文字列の表の場合の値 (整数の表ではNULL)
+    Ast* block;             // 値が一致した場合に実行するブロック (空きの要素はNULL)
+} SwitchCase;
 
 struct Ast {
     AstKind kind;
     int line;
+    Closure* closure;   // 実行用に変換した関数 (変換していなければNULL)
     union {
         // statements
         struct {
@@ -70,12 +123,16 @@ struct Ast {
         struct {
             Ast* cond;
             Ast* block;
+            unsigned long entries;  // ループに入った回数
+            bool optimized;         // 実行中に最適化した
         } repeat_until_stmt;
 
         struct {
             Ast* identifier;
             Ast* collection;
             Ast* block;
+            unsigned long entries;  // ループに入った回数
+            bool optimized;         // 実行中に最適化した
         } repeat_stmt;
 
         // define
@@ -83,8 +140,18 @@ struct Ast {
             Ast* name;
             Ast* params;
             Ast* body;
+            bool is_generator;      // 本体にyieldを含む
+            bool remember;          // 呼び出し結果を引数の値ごとに記録する
+            long memo_limit;        // 記録する数の上限 (0は無制限)
         } func_def;
 
+        // record
+        struct {
+            Ast* name;
+            Ast* fields;
+            Shape* shape;       // 最初に実行したときに作る形
+        } record_def;
+
         struct {
             Ast* statements;
         } block;
@@ -103,8 +170,13 @@ struct Ast {
 
         struct {
             Ast* expr;
+            bool is_tail_call;  // 関数呼び出しの結果をそのまま返す場合は真
         } return_stmt;
 
+        struct {
+            Ast* expr;
+        } yield_stmt;
+
         struct {
             Ast* name;
             Ast* args;
@@ -113,18 +185,21 @@ struct Ast {
         // expressions
         struct {
             char* op;
+            Operator opcode;
             Ast* left;
             Ast* right;
         } binop;
 
         struct {
             char* op;
+            Operator opcode;
             Ast* expr;
         } unary;
 
         // literals
         struct {
             const char* name;
+            InlineCache cache;  // グローバルで見つかった場合の登録場所
         } identifier;
 
         struct {
@@ -177,6 +252,68 @@ struct Ast {
             Ast* from;
             Ast* end;
         } range;
+
+        // map
+        struct {
+            Ast* previous;      // 前に並ぶ要素 (先頭の要素ではNULL)
+            Ast* key;
+            Ast* value;
+        } map_literal;
+
+        struct {
+            Ast* name;          // フィールド名
+            Ast* object;
+            Shape* shape;       // 直前にアクセスしたレコードの形 (なければNULL)
+            int slot;           // 直前の形でのフィールドの位置
+        } field;
+
+        // optimizer
+        struct {
+            bool value;
+        } boolean;
+
+        struct {
+            Object* value;      // 実行時に複製して使う定数
+        } constant;
+
+        struct {
+            Ast* expr;
+            Ast* source;        // 同じ式の値を先に求めるノード (なければNULL)
+            Ast* loop;          // 値がループ内で変わらない場合はそのループ (なければNULL)
+            Object* value;
+            unsigned long epoch;    // 値を求めたときの世代 (0は無効)
+            unsigned long entry;    // 値を求めたときのループに入った回数
+        } cached;
+
+        struct {
+            Ast* expr;          // 数値だけで計算できると推論した式
+            StaticType type;
+            int deopts;         // 数値以外の値が現れて通常の実行に戻った回数
+            int hits;           // 実行した回数 (機械語に変換するまで数えます)
+            JitCode* code;      // 機械語に変換した式 (なければNULL)
+        } unboxed;
+
+        struct {
+            Ast* call;          // 元の関数呼び出し
+            Ast* body;          // 展開した関数の本体 (呼び出す関数が同じであるか確かめるのに使います)
+            Ast* expr;          // 仮引数を引数の番号に置き換えた戻り値の式
+            int argc;
+        } inline_call;
+
+        struct {
+            int index;
+        } argument;
+
+        struct {
+            Ast* subject;       // 定数と比べる変数
+            Ast* chain;         // 元のwhen文 (変数の型が分岐の値の型と異なる場合に実行します)
+            Ast* other;         // どの値とも一致しない場合のブロック (なければNULL)
+            SwitchCase* cases;
+            int size;           // 分岐表の要素数
+            long low;           // 密な整数の表の先頭の値
+            bool is_string;
+            bool is_dense;      // 整数の値から表の位置を直接求める
+        } switch_stmt;
     };
 };
 
@@ -188,13 +325,16 @@ Ast* ast_otherwhen(Ast*, Ast*, Ast*, int);
 Ast* ast_repeat_until(Ast*, Ast*, int);
 Ast* ast_repeat(Ast*, Ast*, Ast*, int);
 Ast* ast_func_def(Ast*, Ast*, Ast*, int);
+Ast* ast_remember(Ast*, Ast*);
 Ast* ast_assign(Ast*, Ast*, bool, int);
 Ast* ast_array_assign(Ast*, Ast*, int);
 Ast* ast_block(Ast*, int);
 Ast* ast_return(Ast*, int);
+Ast* ast_yield(Ast*, int);
 Ast* ast_break(int);
 Ast* ast_continue(int);
 Ast* ast_func_call(Ast*, Ast*, int);
+Ast* ast_record_def(Ast*, Ast*, int);
 Ast* ast_binop(const char*, Ast*, Ast*, int);
 Ast* ast_unary(const char*, Ast*, int);
 Ast* ast_identifier(const char*, int);
@@ -209,6 +349,16 @@ Ast* ast_identifier_list(Ast*, Ast*, int);
 Ast* ast_array_access(Ast*, Ast*, int);
 Ast* ast_slice(Ast*, Ast*, int);
 Ast* ast_range(Ast*, Ast*, int);
+Ast* ast_map(Ast*, Ast*, Ast*, int);
+Ast* ast_field(Ast*, Ast*, int);
+Ast* ast_bool(bool, int);
+Ast* ast_constant(Object*, int);
+Ast* ast_cached(Ast*, Ast*, Ast*);
+Ast* ast_unboxed(Ast*, StaticType);
+Ast* ast_inline(Ast*, Ast*, Ast*, int);
+Ast* ast_argument(int, int);
+Ast* ast_switch(Ast*, Ast*, Ast*, int);
+SwitchCase* switch_case_of(Ast*, long, const char*);
 void print(Ast*);
 void ast_dump(Ast*, int);
 
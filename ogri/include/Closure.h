@@ -0,0 +1,33 @@
+/**
+ * 抽象木を実行用の関数の木に変換します。
+ * 各ノードを、種類に応じた関数と、あらかじめ求めておいた子の関数や定数、変数名のハッシュ値の組に変換し、
+ * 実行時にはノードの種類や演算子、変数名を調べずに関数を呼び出すだけで実行します。
+ * 変換していない種類のノードは通常どおりに実行します。
+ */
+#ifndef __CLOSURE_H__
+#define __CLOSURE_H__
+
+#include "built_in_functions.h"
+
+typedef struct Ast Ast;
+typedef struct environment Environment;
+typedef struct interpreter Interpreter;
+typedef struct object Object;
+
+typedef struct closure Closure;
+typedef Object* (*closure_function)(Closure*, Environment*, Interpreter*);
+
+struct closure {
+    closure_function function;
+    Ast* node;                  // 変換元の抽象木 (エラーの表示と通常の実行に使います)
+    Closure** operands;         // 子の関数 (子がない場所はNULL)
+    int count;
+    Object* constant;           // 定数の値
+    const char* name;           // 変数名または関数名
+    unsigned long hash;         // 代入する変数名のハッシュ値
+    built_in_function builtin;  // 呼び出すと想定したビルトイン関数
+};
+
+void compile_closures(Ast*);
+
+#endif /* __CLOSURE_H__ */
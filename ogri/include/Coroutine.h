@@ -0,0 +1,20 @@
+/**
+ * コルーチンです。
+ * 独自のスタックで関数を実行し、途中で中断・再開することができます。
+ */
+#ifndef __COROUTINE_H__
+#define __COROUTINE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct coroutine Coroutine;
+typedef void (*coroutine_body)(void*);
+
+Coroutine* new_coroutine(coroutine_body, void*, size_t);
+bool coroutine_resume(Coroutine*);
+void coroutine_yield(Coroutine*);
+bool coroutine_running(Coroutine*);
+void coroutine_free(Coroutine*);
+
+#endif /* __COROUTINE_H__ */
@@ -0,0 +1,29 @@
+/**
+ * 先頭と末尾のどちらからでも値を出し入れできる両端キューです。
+ * 要素は環状の配列に並べ、先頭への追加や削除でも要素を動かしません。
+ */
+#ifndef __DEQUE_H__
+#define __DEQUE_H__
+
+#include <stdbool.h>
+
+typedef struct object Object;
+
+typedef struct deque Deque;
+
+struct deque {
+    Object** items;     // 環状の配列
+    int capacity;       // 配列の大きさ (2の累乗)
+    int head;           // 先頭の要素の位置
+    int count;
+};
+
+Deque* newDeque(void);
+void deque_push_back(Deque*, Object*);
+void deque_push_front(Deque*, Object*);
+Object* deque_pop_back(Deque*);
+Object* deque_pop_front(Deque*);
+Object* deque_at(Deque*, long);
+bool deque_set(Deque*, long, Object*);
+
+#endif /* __DEQUE_H__ */
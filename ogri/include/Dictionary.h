@@ -34,6 +34,10 @@ struct dictionary {
 Dictionary* newDict(int);
 bool dict_set(Dictionary*, const char*, Object*);
 HashEntry dict_get(Dictionary*, const char*);
+long dict_index(Dictionary*, const char*);
+unsigned long dict_hash(const char*);
+long dict_index_hashed(Dictionary*, const char*, unsigned long);
+void dict_store(Dictionary*, long, Object*);
 void dict_free(Dictionary*);
 
 extern long seed;
@@ -8,12 +8,21 @@
 
 typedef struct object Object;
 typedef struct dictionary Dictionary;
+typedef struct hashentry HashEntry;
 
 typedef struct environment Environment;
+typedef struct inline_cache InlineCache;
 
 struct environment {
     Dictionary* table;
     Environment* outer;
+    bool captured;      // 関数に取り込まれたスコープは解放しません
+};
+
+// グローバルの識別子の登録場所を、参照する場所ごとに覚えておきます
+struct inline_cache {
+    unsigned long version;  // 覚えたときの世代 (0は無効)
+    HashEntry* entry;
 };
 
 Environment* newEnv(Environment*);
@@ -21,7 +30,11 @@ void env_set(Environment*, const char*, Object*);
 void env_define(Environment*, const char*, Object*);
 void env_assign(Environment*, const char*, Object*, int);
 Object* env_get(Environment*, const char*, int);
+Object* env_get_cached(Environment*, const char*, InlineCache*, int);
+void env_set_hashed(Environment*, const char*, unsigned long, Object*);
 bool env_exists(Environment*, const char*);
+Environment* env_owner(Environment*, const char*);
+void env_capture(Environment*);
 void env_free(Environment*);
 
 
@@ -5,34 +5,74 @@
 #ifndef __EVALUATE_H__
 #define __EVALUATE_H__
 
+#include <stdbool.h>
+
 typedef struct Ast Ast;
 typedef struct environment Environment;
 typedef struct object Object;
 
+typedef struct generator Generator;
+typedef struct _list List;
+
+#define DEFAULT_MAX_CALL_DEPTH 100000
+#define GENERATOR_MAX_DEPTH 1000    // ジェネレーターの本体から呼び出せる関数の深さの上限
+#define FRAME_STACK_SIZE (16 * 1024)   // 関数呼び出し1回あたりに見積もるCのスタックの大きさ
+#define MAX_INLINE_ARGUMENTS 8      // 本体を展開する関数の仮引数の数の上限
+#define OSR_THRESHOLD 10000         // 関数の外のループを実行中に最適化するまでの繰り返しの回数
+
+typedef struct call_frame CallFrame;
+typedef struct call_stack CallStack;
 typedef struct interpreter Interpreter;
 
+struct call_frame {
+    const char* name;   // 呼び出した関数の名前
+    int line;           // 呼び出した行
+};
+
+struct call_stack {
+    List* frames;       // CallFrameのリスト
+    int max_depth;
+    int limit;          // 現在の深さの上限 (ジェネレーターの本体の実行中はmax_depthより小さくなります)
+};
+
 struct interpreter {
     int loop_level;
-    int call_stack_depth;
+    CallStack* call_stack;  // ジェネレーターとも共有します
+    Generator* generator;   // 実行中のジェネレーター (関数の外ではNULL)
+    Object** arguments;     // 本体を展開して実行中の関数の引数
+    Ast* program;           // 実行中にループを最適化する場合のプログラム全体 (最適化しない場合はNULL)
+    Ast* hot_loop;          // 繰り返しを数えている関数の外の最も外側のループ
+    unsigned long iterations;
 };
 
-int evaluate(Ast*);
+int evaluate(Ast*, int, bool);
+void invalidate_caches(void);
+bool is_true(Object*);
+Object* call_object(Object*, List*);
 Object* eval(Ast*, Environment*, Interpreter*);
+Object* eval_node(Ast*, Environment*, Interpreter*);
+Object* assigned_value(Ast*, Object*);
+Object* apply_binop(Ast*, Object*, Object*);
+Object* apply_function(Ast*, Object*, Object*, Interpreter*);
 Object* eval_statements(Ast*, Environment*, Interpreter*);
 Object* eval_block(Ast*, Environment*, Interpreter*);
 Object* eval_repeat(Ast*, Environment*, Interpreter*);
 Object* eval_repeat_until(Ast*, Environment*, Interpreter*);
 Object* eval_when(Ast*, Environment*, Interpreter*);
 Object* eval_otherwhen(Ast*, Environment*, Interpreter*);
+Object* eval_switch(Ast*, Environment*, Interpreter*);
 Object* eval_logical(Ast*, Environment*, Interpreter*);
 Object* eval_binop(Ast*, Environment*, Interpreter*);
 Object* eval_assign(Ast*, Object*, Environment*, Interpreter*);
 Object* eval_func_def(Ast*, Environment*, Interpreter*);
+Object* eval_record_def(Ast*, Environment*, Interpreter*);
 Object* eval_func_call(Ast*, Environment*, Interpreter*);
 Object* eval_unary(Ast*, Environment*, Interpreter*);
 Object* eval_value_list(Ast*, Environment*, Interpreter*);
 Object* eval_array_access(Ast*, Environment*, Interpreter*);
 Object* eval_slice(Ast*, Environment*, Interpreter*);
+Object* eval_map(Ast*, Environment*, Interpreter*);
+Object* eval_field(Ast*, Environment*, Interpreter*);
 Object* eval_fstring(Ast*, Environment*, Interpreter*);
 
 #endif /* __EVALUATE_H__ */
@@ -0,0 +1,33 @@
+/**
+ * ジェネレーターです。
+ * yield文を含む関数の本体をコルーチンとして実行し、値を1つずつ取り出します。
+ */
+#ifndef __GENERATOR_H__
+#define __GENERATOR_H__
+
+#include <stdbool.h>
+#include "Evaluate.h"
+
+typedef struct Ast Ast;
+typedef struct environment Environment;
+typedef struct object Object;
+typedef struct coroutine Coroutine;
+
+typedef struct generator Generator;
+
+struct generator {
+    Coroutine* coroutine;
+    Ast* block;
+    Environment* env;
+    Interpreter interpreter;    // 本体を実行するときの状態
+    Object* value;              // yieldされてまだ取り出されていない値
+    bool has_value;
+};
+
+Generator* newGenerator(Ast*, Environment*, Interpreter*);
+bool generator_has_next(Generator*);
+Object* generator_next(Generator*);
+void generator_yield(Generator*, Object*);
+void dGenerator(Generator*);
+
+#endif /* __GENERATOR_H__ */
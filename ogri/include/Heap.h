@@ -0,0 +1,36 @@
+/**
+ * 最小の値から取り出せる優先度付きキューである二分ヒープです。
+ * 要素は配列に並べ、比べるキーは追加時に1回だけ求めて要素と一緒に持ちます。
+ * キーが等しい要素は追加した順に取り出します。
+ */
+#ifndef __HEAP_H__
+#define __HEAP_H__
+
+#include <stdbool.h>
+
+typedef struct _list List;
+typedef struct object Object;
+
+typedef struct heap_entry HeapEntry;
+typedef struct heap Heap;
+
+struct heap_entry {
+    Object* key;
+    Object* value;
+    long order;             // 追加した順番
+};
+
+struct heap {
+    List* entries;          // ヒープの順に並べた要素
+    Object* key_function;   // キーを求める関数 (値をそのままキーとする場合はNULL)
+    long pushed;            // 追加した要素の数
+};
+
+Heap* newHeap(Object*);
+bool heap_is_key(Object*);
+void heap_push(Heap*, Object*, Object*);
+Object* heap_peek(Heap*);
+Object* heap_pop(Heap*);
+int heap_size(Heap*);
+
+#endif /* __HEAP_H__ */
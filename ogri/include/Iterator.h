@@ -11,11 +11,14 @@ typedef struct object Object;
 typedef struct iterator Iterator;
 
 struct iterator {
-    Object* list;
-    int current;
+    Object* list;       // リスト、両端キュー、等差数列、ジェネレーターまたは遅延評価される列
+    long current;
+    Iterator* source;   // 遅延評価される列の元の列のイテレーター
+    Object* pending;    // filterで先に取り出した値
 };
 
 Iterator* newIterator(Object*);
+void dIterator(Iterator*);
 bool has_next(Iterator*);
 Object* next(Iterator*);
 
@@ -0,0 +1,41 @@
+/**
+ * 数値のまま計算する式を機械語に変換して実行します。
+ * 何度も実行された整数の式をx86-64の機械語に変換し、変数などの値は実行時の関数を呼び出して求めます。
+ * x86-64以外では変換を行いません。
+ */
+#ifndef __JIT_H__
+#define __JIT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define JIT_THRESHOLD 1000      // 機械語に変換するまでに式を実行する回数
+
+typedef struct Ast Ast;
+typedef struct environment Environment;
+typedef struct interpreter Interpreter;
+
+typedef struct jit_context JitContext;
+typedef struct jit_code JitCode;
+
+struct jit_context {
+    Ast** leaves;               // 実行時に値を求める式
+    Environment* env;
+    Interpreter* interpreter;
+    int failed;                 // 整数以外の値が現れた場合は1
+};
+
+struct jit_code {
+    int (*function)(JitContext*, long*);
+    Ast** leaves;
+    void* memory;
+    size_t size;
+};
+
+extern bool jit_enabled;
+
+JitCode* jit_compile(Ast*);
+bool jit_run(JitCode*, Environment*, Interpreter*, long*);
+void jit_free(JitCode*);
+
+#endif /* __JIT_H__ */
@@ -34,6 +34,7 @@ LIST_ERROR get(List*, int, const char*, void*);
 LIST_ERROR reserve(List*, int);
 LIST_ERROR clone(List*, List*);
 LIST_ERROR reverse(List*);
+void* getRef(List*, int);
 int getSize(List*);
 int getCapacity(List*);
 
@@ -0,0 +1,38 @@
+/**
+ * 値をキーとするハッシュテーブルであるマップです。
+ * 文字列、整数、実数をキーにでき、整数と等しい実数は同じ整数のキーとして扱います。
+ * 要素は追加した順に並び、キーの位置はオープンアドレス法の表から求めます。
+ */
+#ifndef __MAP_H__
+#define __MAP_H__
+
+#include <stdbool.h>
+
+typedef struct _list List;
+typedef struct object Object;
+
+typedef struct map_entry MapEntry;
+typedef struct map Map;
+
+struct map_entry {
+    Object* key;            // 削除した要素はNULL
+    Object* value;
+    unsigned long hash;
+};
+
+struct map {
+    MapEntry* entries;      // 追加した順の要素
+    int used;               // 削除した要素を含む要素の数
+    int count;
+    int* slots;             // キーの位置から要素の番号を引く表
+    int capacity;           // 表の大きさ (2の累乗)
+};
+
+Map* newMap(void);
+bool map_is_key(Object*);
+Object* map_get(Map*, Object*);
+void map_set(Map*, Object*, Object*);
+bool map_remove(Map*, Object*);
+List* map_keys(Map*);
+
+#endif /* __MAP_H__ */
@@ -0,0 +1,38 @@
+/**
+ * 関数の呼び出し結果を引数の値ごとに記録するメモです。
+ * 整数、実数、文字列、真偽値と、それらを要素とするリストの引数を値で比べます。
+ * 記録する数に上限がある場合は、最も長く使われていない結果から削除します。
+ */
+#ifndef __MEMO_H__
+#define __MEMO_H__
+
+#include <stdbool.h>
+
+typedef struct object Object;
+
+typedef struct memo_entry MemoEntry;
+typedef struct memo Memo;
+
+struct memo_entry {
+    Object* arguments;
+    Object* value;
+    unsigned long hash;
+    MemoEntry* next;        // 同じバケットの次の要素
+    MemoEntry* newer;       // 次に新しく使われた要素
+    MemoEntry* older;       // 次に古く使われた要素
+};
+
+struct memo {
+    MemoEntry** buckets;
+    int capacity;
+    int count;
+    long limit;             // 記録する数の上限 (0は無制限)
+    MemoEntry* newest;
+    MemoEntry* oldest;
+};
+
+Memo* newMemo(long);
+bool memo_get(Memo*, Object*, Object**);
+void memo_set(Memo*, Object*, Object*);
+
+#endif /* __MEMO_H__ */
@@ -0,0 +1,13 @@
+/**
+ * 数値を文字列に変換します。
+ * 実数は元の値に戻せる最短の桁数(Grisu2)で出力します。
+ */
+#ifndef __NUMBER_FORMAT_H__
+#define __NUMBER_FORMAT_H__
+
+#define NUMBER_BUFFER_SIZE 32     // 変換結果に必要な最大の大きさ (終端文字を含む)
+
+int format_long(char*, long);
+int format_double(char*, double);
+
+#endif /* __NUMBER_FORMAT_H__ */
@@ -1,6 +1,6 @@
 /**
  * オブジェクトです。
- * 整数、実数、文字列、真偽値、関数、リストは全てオブジェクトとして扱われます。
+ * 整数、実数、文字列、真偽値、関数、リスト、型付き配列、マップ、集合、ヒープ、両端キュー、レコード、等差数列、ジェネレーター、遅延評価される列は全てオブジェクトとして扱われます。
  */
 #ifndef __OBJECT_H__
 #define __OBJECT_H__
@@ -9,6 +9,16 @@
 typedef struct Ast Ast;
 typedef struct environment Environment;
 typedef struct _list List;
+typedef struct generator Generator;
+typedef struct sequence Sequence;
+typedef struct memo Memo;
+typedef struct map Map;
+typedef struct set Set;
+typedef struct heap Heap;
+typedef struct deque Deque;
+typedef struct shape Shape;
+typedef struct record Record;
+typedef struct typed_array TypedArray;
 
 typedef enum {
     INTEGER,
@@ -16,15 +26,29 @@ typedef enum {
     STRING,
     BOOL,
     LIST,
+    INT_ARRAY,
+    FLOAT_ARRAY,
+    MAP,
+    SET,
+    HEAP,
+    DEQUE,
+    RECORD,
+    RANGE,
+    GENERATOR,
+    SEQUENCE,
     FUNCTION,
     BUILT_IN_FUNCTION,
+    RECORD_TYPE,
     RETURN,
+    TAIL_CALL,
     BREAK,
     CONTINUE,
     NONE
 } ObjectType;
 
 typedef struct func Function;
+typedef struct range Range;
+typedef struct tail_call TailCall;
 typedef struct object Object;
 
 typedef Object* (*built_in_function)(List* args);
@@ -33,18 +57,42 @@ struct func {
     Ast* params;
     Ast* block;
     Environment* env;
+    bool is_generator;
+    Memo* memo;         // 呼び出し結果の記録 (記録しない関数はNULL)
+};
+struct range {
+    long start;
+    long step;
+    long length;
+};
+struct tail_call {
+    Object* function;
+    Object* arguments;
+    Ast* call;          // エラー表示用の呼び出し元
 };
 struct object {
     ObjectType type;
+    bool is_loop_counter;   // repeat文が繰り返しごとに値を書き換える整数 (変数から読み出すときは複製します)
     union {
         long integer;
         double real;
         char* string;
         bool boolean;
         List* list;
+        TypedArray* array;
+        Map* map;
+        Set* set;
+        Heap* heap;
+        Deque* deque;
+        Record* record;
+        Shape* shape;
+        Range* range;
+        Generator* generator;
+        Sequence* sequence;
         Function* func;
         built_in_function b_func;
         Object* result;
+        TailCall* tail_call;
     };
 };
 
@@ -53,11 +101,30 @@ Object* new_float(double);
 Object* new_string(char*);
 Object* new_bool(bool);
 Object* new_array(List*);
+Object* new_int_array(TypedArray*);
+Object* new_float_array(TypedArray*);
+Object* new_map(Map*);
+Object* new_set(Set*);
+Object* new_heap(Heap*);
+Object* new_deque(Deque*);
+Object* new_record(Record*);
+Object* new_record_type(Shape*);
+Object* new_range(long, long, long);
+Object* new_generator(Generator*);
+Object* new_sequence(Sequence*);
 Object* new_func(Ast*, Ast*, Environment*);
 Object* new_result(Object*);
+Object* new_tail_call(Object*, Object*, Ast*);
 Object* new_break(void);
 Object* new_continue(void);
 
+long range_at(Range*, long);
+List* obj_materialize(Object*);
+bool is_typed_array(Object*);
+Object* typed_at(Object*, long);
+bool typed_set(Object*, long, Object*);
+void obj_prepare_store(Object*, Object*);
+Object* obj_pack(Object*);
 void obj_free(Object*);
 Object* obj_copy(Object*);
 char* obj_toString(Object*);
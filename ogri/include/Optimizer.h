@@ -0,0 +1,15 @@
+/**
+ * 抽象木の最適化です。
+ * 定数の畳み込み、恒等式の簡約、到達しない分岐の削除、ループ不変式と共通部分式の再利用を行い、
+ * 最後に型推論で数値だけの式を数値のまま計算する式に置き換えます。
+ * 実行中に十分に繰り返されたループだけを最適化することもできます。
+ */
+#ifndef __OPTIMIZER_H__
+#define __OPTIMIZER_H__
+
+typedef struct Ast Ast;
+
+Ast* optimize(Ast*);
+void optimize_loop(Ast*, Ast*);
+
+#endif /* __OPTIMIZER_H__ */
@@ -0,0 +1,28 @@
+/**
+ * 標準出力のバッファです。
+ * say/saysの出力はここに溜められ、フラッシュ方針に従って書き出されます。
+ */
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    FLUSH_AUTO,     // 端末なら改行ごと、それ以外はバッファが一杯になったとき
+    FLUSH_LINE,     // 改行ごと
+    FLUSH_FULL,     // バッファが一杯になったときと終了時のみ
+    FLUSH_NONE      // 書き込みごと
+} FlushPolicy;
+
+void output_init(FlushPolicy);
+bool output_parse_policy(const char*, FlushPolicy*);
+void output_write(const char*, size_t);
+void output_string(const char*);
+void output_char(char);
+char* output_reserve(size_t);
+void output_commit(size_t);
+void output_flush(void);
+__attribute__((noreturn)) void output_error(const char*, ...);
+
+#endif /* __OUTPUT_H__ */
@@ -0,0 +1,29 @@
+/**
+ * recordで宣言した型の値であるレコードです。
+ * 型ごとにフィールドの並びを表す形を1つ作り、レコードは形とフィールドの値を1つの領域に並べて持ちます。
+ * フィールドの位置は形から求め、アクセスする式ごとに直前の形と位置を覚えておきます。
+ */
+#ifndef __RECORD_H__
+#define __RECORD_H__
+
+typedef struct object Object;
+
+typedef struct shape Shape;
+typedef struct record Record;
+
+struct shape {
+    const char* name;       // 型の名前
+    int field_count;
+    const char** fields;    // フィールドの名前 (宣言した順)
+};
+
+struct record {
+    Shape* shape;
+    Object* slots[];        // フィールドの値 (形のフィールドと同じ順)
+};
+
+Shape* newShape(const char*, int, const char**);
+int shape_slot(Shape*, const char*);
+Record* newRecord(Shape*);
+
+#endif /* __RECORD_H__ */
@@ -0,0 +1,35 @@
+/**
+ * 遅延評価される列です。
+ * map、filter、takeの結果として作られ、値を要求されたときに元の列から1つずつ計算します。
+ * 列を重ねた場合も中間のリストは作成されません。
+ */
+#ifndef __SEQUENCE_H__
+#define __SEQUENCE_H__
+
+#include <stdbool.h>
+
+typedef struct object Object;
+typedef struct iterator Iterator;
+
+typedef enum {
+    SEQUENCE_MAP,
+    SEQUENCE_FILTER,
+    SEQUENCE_TAKE
+} SequenceKind;
+
+typedef struct sequence Sequence;
+
+struct sequence {
+    SequenceKind kind;
+    Object* function;   // mapとfilterで呼び出す関数
+    Object* source;     // 元の列
+    long count;         // takeで取り出す個数
+};
+
+Sequence* newSequence(SequenceKind, Object*, Object*, long);
+bool is_iterable(Object*);
+long sequence_length(Object*);
+bool sequence_has_next(Iterator*);
+Object* sequence_next(Iterator*);
+
+#endif /* __SEQUENCE_H__ */
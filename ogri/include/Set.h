@@ -0,0 +1,35 @@
+/**
+ * 重複のない値の集まりである集合です。
+ * 小さな0以上の整数だけを含む間はビット列で表し、和・積・差や要素数を1語ずつまとめて計算します。
+ * それ以外の値を含むとマップで表します。
+ */
+#ifndef __SET_H__
+#define __SET_H__
+
+#include <stdbool.h>
+
+#define SET_BITSET_LIMIT 65536  // ビット列で表す整数の上限 (この値未満)
+
+typedef struct _list List;
+typedef struct object Object;
+typedef struct map Map;
+
+typedef struct set Set;
+
+struct set {
+    unsigned long* words;   // ビット列 (マップで表す場合は使いません)
+    int word_count;
+    int count;
+    Map* table;             // ビット列で表せない値を含む場合の表 (ビット列で表す場合はNULL)
+};
+
+Set* newSet(void);
+bool set_add(Set*, Object*);
+bool set_has(Set*, Object*);
+bool set_remove(Set*, Object*);
+Set* set_union(Set*, Set*);
+Set* set_intersection(Set*, Set*);
+Set* set_difference(Set*, Set*);
+List* set_items(Set*);
+
+#endif /* __SET_H__ */
@@ -0,0 +1,13 @@
+/**
+ * 型推論です。
+ * 文の流れに沿って変数の型を推論し、数値だけで計算できる式を数値のまま計算する式に置き換えます。
+ * 推論が外れた場合は実行時に通常の実行に戻るため、推論は実行結果を変えません。
+ */
+#ifndef __TYPE_INFERENCE_H__
+#define __TYPE_INFERENCE_H__
+
+typedef struct Ast Ast;
+
+void infer_types(Ast*);
+
+#endif /* __TYPE_INFERENCE_H__ */
@@ -0,0 +1,35 @@
+/**
+ * 整数だけ、または実数だけを並べた型付き配列です。
+ * 要素をオブジェクトにせず、longまたはdoubleの連続した領域に並べて持ちます。
+ * 整数と実数のどちらの配列であるかはオブジェクトの型で区別します。
+ */
+#ifndef __TYPED_ARRAY_H__
+#define __TYPED_ARRAY_H__
+
+#include <stdbool.h>
+
+typedef struct typed_array TypedArray;
+
+struct typed_array {
+    union {
+        long* integers;
+        double* reals;
+    };
+    long length;
+    long capacity;
+};
+
+TypedArray* newTypedArray(long);
+void typed_array_reserve(TypedArray*, long);
+void typed_array_push_integer(TypedArray*, long);
+void typed_array_push_real(TypedArray*, double);
+TypedArray* typed_array_slice(TypedArray*, long, long);
+long typed_array_sum_integers(TypedArray*);
+double typed_array_sum_reals(TypedArray*);
+long typed_array_dot_integers(TypedArray*, TypedArray*);
+double typed_array_dot_reals(TypedArray*, TypedArray*);
+long typed_array_extreme_integers(TypedArray*, bool);
+long typed_array_extreme_reals(TypedArray*, bool);
+void dTypedArray(TypedArray*);
+
+#endif /* __TYPED_ARRAY_H__ */
@@ -17,6 +17,7 @@ struct builtins {
 };
 
 void set_builtins(Environment*);
+built_in_function find_builtin(const char*);
 Object* builtin_say(List*);
 Object* builtin_says(List*);
 Object* builtin_to_int(List*);
@@ -25,5 +26,34 @@ Object* builtin_range(List*);
 Object* builtin_len(List*);
 Object* builtin_push(List*);
 Object* builtin_pop(List*);
+Object* builtin_map(List*);
+Object* builtin_filter(List*);
+Object* builtin_reduce(List*);
+Object* builtin_take(List*);
+Object* builtin_dict(List*);
+Object* builtin_has(List*);
+Object* builtin_keys(List*);
+Object* builtin_remove(List*);
+Object* builtin_set(List*);
+Object* builtin_add(List*);
+Object* builtin_union(List*);
+Object* builtin_intersection(List*);
+Object* builtin_difference(List*);
+Object* builtin_heap(List*);
+Object* builtin_heap_push(List*);
+Object* builtin_heap_pop(List*);
+Object* builtin_heap_peek(List*);
+Object* builtin_deque(List*);
+Object* builtin_push_front(List*);
+Object* builtin_pop_front(List*);
+Object* builtin_int_array(List*);
+Object* builtin_float_array(List*);
+Object* builtin_sum(List*);
+Object* builtin_mean(List*);
+Object* builtin_min(List*);
+Object* builtin_max(List*);
+Object* builtin_argmin(List*);
+Object* builtin_argmax(List*);
+Object* builtin_dot(List*);
 
 #endif /* BUILT_IN_FUNCTIONS_H__ */
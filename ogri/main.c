@@ -3,28 +3,57 @@
 #include <time.h>
 #include <unistd.h>
 #include "defs.h"
+#include "Closure.h"
 #include "Evaluate.h"
+#include "Jit.h"
 #include "Object.h"
 #include "Dictionary.h"
+#include "Optimizer.h"
+#include "Output.h"
 
 long seed;
 Ast* root_ast = NULL;
 
 void usage(const char* program)
 {
-	fprintf(stderr, "Usage: %s [-p] [-e] [filename]\n", program);
+	fprintf(stderr, "Usage: %s [-p] [-e] [-O] [-J] [-C] [-b policy] [-s depth] [filename]\n", program);
     fprintf(stderr, "  -p: Print Abstract Syntax Tree (AST)\n");
     fprintf(stderr, "  -e: Evaluate (Execute) the program\n");
+    fprintf(stderr, "  -O: Optimize the AST before printing or evaluating\n");
+    fprintf(stderr, "  -J: Disable optimizing hot loops and compiling hot expressions at run time\n");
+    fprintf(stderr, "  -C: Evaluate with functions compiled from the AST instead of walking the AST\n");
+    fprintf(stderr, "  -b: Output flush policy (auto, line, full, none). default: auto\n");
+    fprintf(stderr, "  -s: Maximum depth of function calls. default: %d\n", DEFAULT_MAX_CALL_DEPTH);
 }
 
 extern FILE *yyin;
 int main(int argc, char** argv) {
 	int option;
 	int print_mode = 0;
+	int optimize_mode = 0;
+	int closure_mode = 0;
+	FlushPolicy policy = FLUSH_AUTO;
+	int max_depth = DEFAULT_MAX_CALL_DEPTH;
 
-	while((option = getopt(argc, argv, "p")) != -1) {
+	while((option = getopt(argc, argv, "pOJCb:s:")) != -1) {
 		switch(option) {
 			case 'p': print_mode = 1; break;
+			case 'O': optimize_mode = 1; break;
+			case 'J': jit_enabled = false; break;
+			case 'C': closure_mode = 1; break;
+			case 'b':
+				if(!output_parse_policy(optarg, &policy)) {
+					usage(argv[0]);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 's':
+				max_depth = atoi(optarg);
+				if(max_depth <= 0) {
+					usage(argv[0]);
+					return EXIT_FAILURE;
+				}
+				break;
 			default:
 				(usage(argv[0]));
 				return EXIT_FAILURE;
@@ -36,6 +65,7 @@ int main(int argc, char** argv) {
 		yyin = fp;
 	}
 
+	output_init(policy);
 	linecounter = 1;
 	srand(time(NULL));
 	seed = rand();
@@ -46,9 +76,13 @@ int main(int argc, char** argv) {
 			return EXIT_FAILURE;
 		}
 
+		if(optimize_mode) root_ast = optimize(root_ast);
+
 		if(print_mode) print(root_ast);
 		else {
-			int code = evaluate(root_ast);
+			if(closure_mode) compile_closures(root_ast);
+			int code = evaluate(root_ast, max_depth, !optimize_mode && jit_enabled);
+			output_flush();
 			fprintf(stderr, "Program end code with %d\n", code);
 		}
 
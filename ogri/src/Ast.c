@@ -1,5 +1,7 @@
 
 #include "defs.h"
+#include "Dictionary.h"
+#include "Object.h"
 
 /**
  * 抽象木のメモリを確保し、種類を設定します。
@@ -8,6 +10,7 @@ Ast* new_ast(AstKind kind)
 {
     Ast* node = malloc(sizeof(Ast));
     node->kind = kind;
+    node->closure = NULL;
     return node;
 }
 /**
@@ -58,6 +61,8 @@ Ast* ast_repeat_until(Ast* cond, Ast* block, int line)
     node->line = line;
     node->repeat_until_stmt.cond = cond;
     node->repeat_until_stmt.block = block;
+    node->repeat_until_stmt.entries = 0;
+    node->repeat_until_stmt.optimized = false;
     return node;
 }
 
@@ -71,11 +76,89 @@ Ast* ast_repeat(Ast* identifier, Ast* collection, Ast* block, int line)
     node->repeat_stmt.identifier = identifier;
     node->repeat_stmt.collection = collection;
     node->repeat_stmt.block = block;
+    node->repeat_stmt.entries = 0;
+    node->repeat_stmt.optimized = false;
     return node;
 }
 
+/**
+ * 文の中にyield文が含まれているか判定します。
+ * 入れ子の関数定義の中は探索しません。
+ */
+static bool contains_yield(Ast* node)
+{
+    if(node == NULL) return false;
+    switch(node->kind) {
+        case AST_YIELD:
+            return true;
+        case AST_STATEMENTS:
+            return contains_yield(node->list.first) || contains_yield(node->list.next);
+        case AST_BLOCK:
+            return contains_yield(node->block.statements);
+        case AST_WHEN:
+            return contains_yield(node->when_stmt.then_block) ||
+                    contains_yield(node->when_stmt.otherwhen_list) ||
+                    contains_yield(node->when_stmt.other_block);
+        case AST_OTHERWHEN:
+            return contains_yield(node->otherwhen.block) || contains_yield(node->otherwhen.next);
+        case AST_REPEAT:
+            return contains_yield(node->repeat_stmt.block);
+        case AST_REPEAT_UNTIL:
+            return contains_yield(node->repeat_until_stmt.block);
+        default:
+            return false;
+    }
+}
+
+/**
+ * 関数呼び出しの結果をそのまま返すreturn文に末尾呼び出しの印を付けます。
+ * 入れ子の関数定義の中は探索しません。
+ */
+static void mark_tail_calls(Ast* node)
+{
+    if(node == NULL) return;
+    switch(node->kind) {
+        case AST_RETURN: {
+            Ast* expr = node->return_stmt.expr;
+            if(expr != NULL && expr->kind == AST_VALUE_LIST && expr->value_list.next == NULL)
+                expr = expr->value_list.first;
+            if(expr != NULL && expr->kind == AST_FUNC_CALL) {
+                node->return_stmt.expr = expr;
+                node->return_stmt.is_tail_call = true;
+            }
+            break;
+        }
+        case AST_STATEMENTS:
+            mark_tail_calls(node->list.first);
+            mark_tail_calls(node->list.next);
+            break;
+        case AST_BLOCK:
+            mark_tail_calls(node->block.statements);
+            break;
+        case AST_WHEN:
+            mark_tail_calls(node->when_stmt.then_block);
+            mark_tail_calls(node->when_stmt.otherwhen_list);
+            mark_tail_calls(node->when_stmt.other_block);
+            break;
+        case AST_OTHERWHEN:
+            mark_tail_calls(node->otherwhen.block);
+            mark_tail_calls(node->otherwhen.next);
+            break;
+        case AST_REPEAT:
+            mark_tail_calls(node->repeat_stmt.block);
+            break;
+        case AST_REPEAT_UNTIL:
+            mark_tail_calls(node->repeat_until_stmt.block);
+            break;
+        default:
+            break;
+    }
+}
+
 /**
  * 関数定義の抽象木を作成します。
+ * 本体にyield文を含む関数はジェネレーターとなります。
+ * ジェネレーターでない関数では末尾呼び出しを検出します。
  */
 Ast* ast_func_def(Ast* name, Ast* params, Ast* body, int line)
 {
@@ -84,6 +167,21 @@ Ast* ast_func_def(Ast* name, Ast* params, Ast* body, int line)
     node->func_def.name = name;
     node->func_def.params = params;
     node->func_def.body = body;
+    node->func_def.is_generator = contains_yield(body);
+    node->func_def.remember = false;
+    node->func_def.memo_limit = 0;
+    if(!node->func_def.is_generator) mark_tail_calls(body);
+    return node;
+}
+
+/**
+ * 関数定義に、呼び出し結果を引数の値ごとに記録する指定を加えます。
+ * limitがあれば、その数を記録する数の上限とします。
+ */
+Ast* ast_remember(Ast* node, Ast* limit)
+{
+    node->func_def.remember = true;
+    node->func_def.memo_limit = (limit != NULL) ? limit->integer.value : 0;
     return node;
 }
 
@@ -131,6 +229,18 @@ Ast* ast_return(Ast* expr, int line)
     Ast* node = new_ast(AST_RETURN);
     node->line = line;
     node->return_stmt.expr = expr;
+    node->return_stmt.is_tail_call = false;
+    return node;
+}
+
+/**
+ * yield文の抽象木を作成します。
+ */
+Ast* ast_yield(Ast* expr, int line)
+{
+    Ast* node = new_ast(AST_YIELD);
+    node->line = line;
+    node->yield_stmt.expr = expr;
     return node;
 }
 
@@ -166,6 +276,17 @@ Ast* ast_func_call(Ast* name, Ast* args, int line)
     return node;
 }
 
+/**
+ * 演算子の文字列から演算子の種類を返します。
+ */
+static Operator operator_of(const char* op)
+{
+    const char* names[] = { "+", "-", "*", "/", "%", "==", "!=", "<", ">", "<=", ">=", "and", "or", "not" };
+    for(int index = 0; index < OP_OTHER; index++)
+        if(strcmp(op, names[index]) == 0) return (Operator)index;
+    return OP_OTHER;
+}
+
 /**
  * 二項演算の抽象木を作成します。
  */
@@ -174,6 +295,7 @@ Ast* ast_binop(const char* op, Ast* left, Ast* right, int line)
     Ast* node = new_ast(AST_BINOP);
     node->line = line;
     node->binop.op = strdup(op);
+    node->binop.opcode = operator_of(op);
     node->binop.left = left;
     node->binop.right = right;
     return node;
@@ -187,6 +309,7 @@ Ast* ast_unary(const char* op, Ast* expr, int line)
     Ast* node = new_ast(AST_UNARY);
     node->line = line;
     node->unary.op = strdup(op);
+    node->unary.opcode = operator_of(op);
     node->unary.expr = expr;
     return node;
 }
@@ -199,6 +322,8 @@ Ast* ast_identifier(const char* name, int line)
     Ast* node = new_ast(AST_IDENTIFIER);
     node->line = line;
     node->identifier.name = strdup(name);
+    node->identifier.cache.version = 0;
+    node->identifier.cache.entry = NULL;
     return node;
 }
 
@@ -328,6 +453,176 @@ Ast* ast_range(Ast* from, Ast* end, int line)
     return node;
 }
 
+/**
+ * マップの要素の抽象木を作成します。
+ * 要素はpreviousを前に連ねた形で並びます。
+ */
+Ast* ast_map(Ast* previous, Ast* key, Ast* value, int line)
+{
+    Ast* node = new_ast(AST_MAP);
+    node->line = line;
+    node->map_literal.previous = previous;
+    node->map_literal.key = key;
+    node->map_literal.value = value;
+    return node;
+}
+
+/**
+ * レコードの型の宣言の抽象木を作成します。
+ */
+Ast* ast_record_def(Ast* name, Ast* fields, int line)
+{
+    Ast* node = new_ast(AST_RECORD_DEF);
+    node->line = line;
+    node->record_def.name = name;
+    node->record_def.fields = fields;
+    node->record_def.shape = NULL;
+    return node;
+}
+
+/**
+ * レコードのフィールドへのアクセスの抽象木を作成します。
+ */
+Ast* ast_field(Ast* name, Ast* object, int line)
+{
+    Ast* node = new_ast(AST_FIELD);
+    node->line = line;
+    node->field.name = name;
+    node->field.object = object;
+    node->field.shape = NULL;
+    node->field.slot = 0;
+    return node;
+}
+
+/**
+ * 真偽値の抽象木を作成します。
+ * 構文には現れず、最適化で式を畳み込んだときに作成されます。
+ */
+Ast* ast_bool(bool value, int line)
+{
+    Ast* node = new_ast(AST_BOOL);
+    node->line = line;
+    node->boolean.value = value;
+    return node;
+}
+
+/**
+ * 定数の抽象木を作成します。
+ * 構文には現れず、最適化で定数だけの値リストを畳み込んだときに作成されます。
+ */
+Ast* ast_constant(Object* value, int line)
+{
+    Ast* node = new_ast(AST_CONSTANT);
+    node->line = line;
+    node->constant.value = value;
+    return node;
+}
+
+/**
+ * 求めた値を再利用する式の抽象木を作成します。
+ * sourceがあればその値を、loopがあればループ内で最初に求めた値を再利用します。
+ */
+Ast* ast_cached(Ast* expr, Ast* source, Ast* loop)
+{
+    Ast* node = new_ast(AST_CACHED);
+    node->line = expr->line;
+    node->cached.expr = expr;
+    node->cached.source = source;
+    node->cached.loop = loop;
+    node->cached.value = NULL;
+    node->cached.epoch = 0;
+    node->cached.entry = 0;
+    return node;
+}
+
+/**
+ * 数値のまま計算する式の抽象木を作成します。
+ */
+Ast* ast_unboxed(Ast* expr, StaticType type)
+{
+    Ast* node = new_ast(AST_UNBOXED);
+    node->line = expr->line;
+    node->unboxed.expr = expr;
+    node->unboxed.type = type;
+    node->unboxed.deopts = 0;
+    node->unboxed.hits = 0;
+    node->unboxed.code = NULL;
+    return node;
+}
+
+/**
+ * 関数の本体を展開した呼び出しの抽象木を作成します。
+ */
+Ast* ast_inline(Ast* call, Ast* body, Ast* expr, int argc)
+{
+    Ast* node = new_ast(AST_INLINE);
+    node->line = call->line;
+    node->inline_call.call = call;
+    node->inline_call.body = body;
+    node->inline_call.expr = expr;
+    node->inline_call.argc = argc;
+    return node;
+}
+
+/**
+ * 展開した関数の引数の抽象木を作成します。
+ */
+Ast* ast_argument(int index, int line)
+{
+    Ast* node = new_ast(AST_ARGUMENT);
+    node->line = line;
+    node->argument.index = index;
+    return node;
+}
+
+/**
+ * 分岐表で実行するwhen文の抽象木を作成します。
+ * 構文には現れず、最適化で同じ変数を定数と比べるwhen文を置き換えたときに作成されます。
+ * 分岐表は作成した側で設定します。
+ */
+Ast* ast_switch(Ast* subject, Ast* chain, Ast* other, int line)
+{
+    Ast* node = new_ast(AST_SWITCH);
+    node->line = line;
+    node->switch_stmt.subject = subject;
+    node->switch_stmt.chain = chain;
+    node->switch_stmt.other = other;
+    node->switch_stmt.cases = NULL;
+    node->switch_stmt.size = 0;
+    node->switch_stmt.low = 0;
+    node->switch_stmt.is_string = false;
+    node->switch_stmt.is_dense = false;
+    return node;
+}
+
+/**
+ * 分岐表から値の要素を探します。
+ * 値がなければ値を追加できる空きの要素を、密な整数の表の範囲外であればNULLを返します。
+ */
+SwitchCase* switch_case_of(Ast* node, long integer, const char* string)
+{
+    SwitchCase* cases = node->switch_stmt.cases;
+    if(node->switch_stmt.is_dense) {
+        unsigned long offset = (unsigned long)integer - (unsigned long)node->switch_stmt.low;
+        return (offset < (unsigned long)node->switch_stmt.size) ? &cases[offset] : NULL;
+    }
+
+    unsigned long hash;
+    if(string != NULL) {
+        hash = dict_hash(string);
+    } else {
+        hash = (unsigned long)integer * 0x9E3779B97F4A7C15UL;
+        hash ^= hash >> 32;
+    }
+    unsigned long mask = (unsigned long)node->switch_stmt.size - 1;
+    // 表の大きさは分岐の数の2倍以上あるため、必ず空きの要素が見つかります。
+    for(unsigned long index = hash & mask; ; index = (index + 1) & mask) {
+        SwitchCase* entry = &cases[index];
+        if(entry->block == NULL) return entry;
+        if(string != NULL ? strcmp(entry->string, string) == 0 : entry->integer == integer) return entry;
+    }
+}
+
 /**
  * インデントを出力します。
  */
@@ -360,9 +655,11 @@ void ast_dump(Ast* node, int depth)
     "ASSIGN",
     "ARRAY_ASSIGN",
     "RETURN",
+    "YIELD",
     "BREAK",
     "CONTINUE",
     "FUNC_CALL",
+    "RECORD_DEF",
     "BLOCK",
     "BINOP",
     "UNARY",
@@ -377,7 +674,16 @@ void ast_dump(Ast* node, int depth)
     "IDENTIFIER_LIST",
     "ARRAY_ACCESS",
     "SLICE",
-    "RANGE"
+    "RANGE",
+    "MAP",
+    "FIELD",
+    "BOOL",
+    "CONSTANT",
+    "CACHED",
+    "UNBOXED",
+    "INLINE",
+    "ARGUMENT",
+    "SWITCH"
     };
 
     printf("\n");
@@ -416,6 +722,7 @@ void ast_dump(Ast* node, int depth)
             ast_dump(node->repeat_stmt.block, depth+1);
             break;
         case AST_FUNC_DEF:
+            if(node->func_def.remember) printf("(remember %ld)", node->func_def.memo_limit);
             ast_dump(node->func_def.name, depth+1);
             ast_dump(node->func_def.params, depth+1);
             ast_dump(node->func_def.body, depth+1);
@@ -429,8 +736,12 @@ void ast_dump(Ast* node, int depth)
             ast_dump(node->assign_array.right, depth+1);
             break;
         case AST_RETURN:
+            if(node->return_stmt.is_tail_call) printf("(tail call)");
             ast_dump(node->return_stmt.expr, depth+1);
             break;
+        case AST_YIELD:
+            ast_dump(node->yield_stmt.expr, depth+1);
+            break;
         case AST_BREAK:
         case AST_CONTINUE:
             break;
@@ -492,5 +803,52 @@ void ast_dump(Ast* node, int depth)
             ast_dump(node->range.from, depth+1);
             ast_dump(node->range.end, depth+1);
             break;
+        case AST_MAP:
+            ast_dump(node->map_literal.previous, depth+1);
+            ast_dump(node->map_literal.key, depth+1);
+            ast_dump(node->map_literal.value, depth+1);
+            break;
+        case AST_RECORD_DEF:
+            ast_dump(node->record_def.name, depth+1);
+            ast_dump(node->record_def.fields, depth+1);
+            break;
+        case AST_FIELD:
+            printf("%s", node->field.name->identifier.name);
+            ast_dump(node->field.object, depth+1);
+            break;
+        case AST_BOOL:
+            printf("%s", node->boolean.value ? "true" : "false");
+            break;
+        case AST_CONSTANT: {
+            char* string = obj_toString(node->constant.value);
+            printf("%s", string);
+            free(string);
+            break;
+        }
+        case AST_CACHED:
+            if(node->cached.loop != NULL) printf("(loop invariant)");
+            else if(node->cached.source != NULL) printf("(reuse)");
+            else printf("(shared)");
+            ast_dump(node->cached.expr, depth+1);
+            break;
+        case AST_UNBOXED: {
+            const char* types[] = { "any", "integer", "float", "bool", "string", "list" };
+            printf("(%s)", types[node->unboxed.type]);
+            ast_dump(node->unboxed.expr, depth+1);
+            break;
+        }
+        case AST_INLINE:
+            printf("%s", node->inline_call.call->func_call.name->identifier.name);
+            ast_dump(node->inline_call.call->func_call.args, depth+1);
+            ast_dump(node->inline_call.expr, depth+1);
+            break;
+        case AST_ARGUMENT:
+            printf("%d", node->argument.index);
+            break;
+        case AST_SWITCH:
+            printf("%s (%s)", node->switch_stmt.subject->identifier.name,
+                    node->switch_stmt.is_dense ? "jump table" : "hashed");
+            ast_dump(node->switch_stmt.chain, depth+1);
+            break;
     }
 }
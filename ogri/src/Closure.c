@@ -0,0 +1,441 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "Ast.h"
+#include "built_in_functions.h"
+#include "Closure.h"
+#include "Dictionary.h"
+#include "Environment.h"
+#include "Evaluate.h"
+#include "List.h"
+#include "Object.h"
+#include "Output.h"
+
+/**
+ * 関数を実行します。子がない場所(NULL)はNULLを返します。
+ */
+static inline Object* run(Closure* closure, Environment* env, Interpreter* interpreter)
+{
+    return (closure == NULL) ? NULL : closure->function(closure, env, interpreter);
+}
+
+/**
+ * 変換していない種類のノードを通常どおりに実行します。
+ * 子は変換した関数で実行されます。
+ */
+static Object* run_node(Closure* self, Environment* env, Interpreter* interpreter)
+{
+    return eval_node(self->node, env, interpreter);
+}
+
+static Object* run_constant(Closure* self, Environment* env, Interpreter* interpreter)
+{
+    (void)env;
+    (void)interpreter;
+    return self->constant;
+}
+
+static Object* run_identifier(Closure* self, Environment* env, Interpreter* interpreter)
+{
+    Object* value = env_get_cached(env, self->name, &self->node->identifier.cache, self->node->line);
+    if(value == NULL) return eval_node(self->node, env, interpreter);
+    if(value->is_loop_counter) return new_int(value->integer);
+    return value;
+}
+
+static Object* run_statements(Closure* self, Environment* env, Interpreter* interpreter)
+{
+    Object* result = NULL;
+    for(int index = 0; index < self->count; index++) {
+        if(self->operands[index] == NULL) continue;
+        result = run(self->operands[index], env, interpreter);
+        if(result != NULL && (result->type == RETURN || result->type == BREAK || result->type == CONTINUE))
+            return result;
+    }
+    return result;
+}
+
+static Object* run_block(Closure* self, Environment* env, Interpreter* interpreter)
+{
+    if(self->operands[0] == NULL) return NULL;
+    Environment* scope = newEnv(env);
+    Object* result = run(self->operands[0], scope, interpreter);
+    if(!scope->captured) env_free(scope);
+    return result;
+}
+
+static Object* run_assign(Closure* self, Environment* env, Interpreter* interpreter)
+{
+    Object* value = assigned_value(self->node, run(self->operands[0], env, interpreter));
+    env_set_hashed(env, self->name, self->hash, value);
+    return value;
+}
+
+static Object* run_and(Closure* self, Environment* env, Interpreter* interpreter)
+{
+    Object* left = run(self->operands[0], env, interpreter);
+    if(!is_true(left)) return left;
+    return run(self->operands[1], env, interpreter);
+}
+
+static Object* run_or(Closure* self, Environment* env, Interpreter* interpreter)
+{
+    Object* left = run(self->operands[0], env, interpreter);
+    if(is_true(left)) return left;
+    return run(self->operands[1], env, interpreter);
+}
+
+/**
+ * 整数どうしの場合だけをその場で計算する二項演算の関数を定義します。
+ * NAMEは右辺を実行する関数、NAME_constantは右辺が整数の定数の関数です。
+ * 整数どうし以外の場合や、エラーになり得る場合は通常の二項演算に任せます。
+ */
+#define INTEGER_BINOP(NAME, RESULT)                                                             \
+    static Object* run_##NAME(Closure* self, Environment* env, Interpreter* interpreter)       \
+    {                                                                                           \
+        Object* left = run(self->operands[0], env, interpreter);                               \
+        Object* right = run(self->operands[1], env, interpreter);                              \
+        if(left->type == INTEGER && right->type == INTEGER) {                                  \
+            long a = left->integer, b = right->integer;                                        \
+            return RESULT;                                                                      \
+        }                                                                                       \
+        return apply_binop(self->node, left, right);                                           \
+    }                                                                                           \
+    static Object* run_##NAME##_constant(Closure* self, Environment* env, Interpreter* interpreter) \
+    {                                                                                           \
+        Object* left = run(self->operands[0], env, interpreter);                               \
+        Object* right = self->constant;                                                         \
+        if(left->type == INTEGER) {                                                             \
+            long a = left->integer, b = right->integer;                                        \
+            return RESULT;                                                                      \
+        }                                                                                       \
+        return apply_binop(self->node, left, right);                                           \
+    }
+
+INTEGER_BINOP(add, new_int(a + b))
+INTEGER_BINOP(sub, new_int(a - b))
+INTEGER_BINOP(mul, new_int(a * b))
+INTEGER_BINOP(div, (b == 0 || b == -1) ? apply_binop(self->node, left, right) : new_int(a / b))
+INTEGER_BINOP(mod, (b == 0 || b == -1) ? apply_binop(self->node, left, right) : new_int(a % b))
+INTEGER_BINOP(eq, new_bool(a == b))
+INTEGER_BINOP(ne, new_bool(a != b))
+INTEGER_BINOP(lt, new_bool(a < b))
+INTEGER_BINOP(gt, new_bool(a > b))
+INTEGER_BINOP(le, new_bool(a <= b))
+INTEGER_BINOP(ge, new_bool(a >= b))
+
+static Object* run_call(Closure* self, Environment* env, Interpreter* interpreter)
+{
+    Object* function = env_get_cached(env, self->name, &self->node->func_call.name->identifier.cache, self->node->line);
+    if(function == NULL || (function->type != FUNCTION && function->type != BUILT_IN_FUNCTION))
+        return eval_node(self->node, env, interpreter);
+    Object* arguments = run(self->operands[0], env, interpreter);
+    return apply_function(self->node, function, arguments, interpreter);
+}
+
+/**
+ * 引数が1つのビルトイン関数の呼び出しです。
+ * 名前が別の値に束縛されている場合は通常の関数呼び出しとして実行します。
+ */
+static Object* run_builtin_call(Closure* self, Environment* env, Interpreter* interpreter)
+{
+    Object* function = env_get_cached(env, self->name, &self->node->func_call.name->identifier.cache, self->node->line);
+    if(function == NULL || function->type != BUILT_IN_FUNCTION || function->b_func != self->builtin)
+        return run_call(self, env, interpreter);
+
+    // 値リストと同じく、値のない引数は空のリストとして渡します。
+    Object* argument = run(self->operands[1], env, interpreter);
+    if(argument == NULL) argument = new_array(newList(Object*));
+    List* args = newList(Object*);
+    add(args, &argument);
+    Object* result = self->builtin(args);
+    dList(args);
+    return result;
+}
+
+static Object* run_value_list(Closure* self, Environment* env, Interpreter* interpreter)
+{
+    List* list = newList(Object*);
+    for(int index = 0; index < self->count; index++) {
+        Object* value = run(self->operands[index], env, interpreter);
+        if(value != NULL) add(list, &value);
+    }
+    if(getSize(list) == 1) {
+        Object* single;
+        getAt(list, 0, Object*, &single);
+        dList(list);
+        return single;
+    }
+    return new_array(list);
+}
+
+static Closure* compile(Ast*);
+
+/**
+ * 子の関数を置く場所を用意します。
+ */
+static void set_operands(Closure* closure, int count)
+{
+    closure->operands = malloc(sizeof(Closure*) * (count > 0 ? count : 1));
+    if(closure->operands == NULL) {
+        output_error("Runtime Error: Failed to compile AST.\n");
+    }
+    closure->count = count;
+}
+
+/**
+ * 値リストの要素を左から順に数えます。
+ */
+static int count_values(Ast* node)
+{
+    if(node != NULL && node->kind == AST_VALUE_LIST)
+        return count_values(node->value_list.first) + 1;
+    return 1;
+}
+
+/**
+ * 値リストの要素を変換し、左から順に置きます。
+ */
+static int compile_values(Ast* node, Closure** operands)
+{
+    if(node != NULL && node->kind == AST_VALUE_LIST) {
+        int index = compile_values(node->value_list.first, operands);
+        operands[index] = compile(node->value_list.next);
+        return index + 1;
+    }
+    operands[0] = compile(node);
+    return 1;
+}
+
+/**
+ * 二項演算の関数を選びます。
+ */
+static closure_function binop_function(Operator op, bool is_constant)
+{
+    switch(op) {
+        case OP_ADD: return is_constant ? run_add_constant : run_add;
+        case OP_SUB: return is_constant ? run_sub_constant : run_sub;
+        case OP_MUL: return is_constant ? run_mul_constant : run_mul;
+        case OP_DIV: return is_constant ? run_div_constant : run_div;
+        case OP_MOD: return is_constant ? run_mod_constant : run_mod;
+        case OP_EQ:  return is_constant ? run_eq_constant : run_eq;
+        case OP_NE:  return is_constant ? run_ne_constant : run_ne;
+        case OP_LT:  return is_constant ? run_lt_constant : run_lt;
+        case OP_GT:  return is_constant ? run_gt_constant : run_gt;
+        case OP_LE:  return is_constant ? run_le_constant : run_le;
+        case OP_GE:  return is_constant ? run_ge_constant : run_ge;
+        case OP_AND: return run_and;
+        case OP_OR:  return run_or;
+        default:     return run_node;
+    }
+}
+
+/**
+ * 二項演算を変換します。
+ */
+static void compile_binop(Closure* closure, Ast* node)
+{
+    Ast* right = node->binop.right;
+    bool is_constant = (right->kind == AST_INTEGER);
+    set_operands(closure, 2);
+    closure->operands[0] = compile(node->binop.left);
+    closure->operands[1] = compile(right);
+    if(is_constant) closure->constant = new_int(right->integer.value);
+    closure->function = binop_function(node->binop.opcode, is_constant);
+}
+
+/**
+ * 関数呼び出しを変換します。
+ * 引数が1つのビルトイン関数の呼び出しは、値リストを作らずに呼び出します。
+ */
+static void compile_call(Closure* closure, Ast* node)
+{
+    Ast* args = node->func_call.args;
+    closure->name = node->func_call.name->identifier.name;
+    closure->builtin = find_builtin(closure->name);
+    set_operands(closure, 2);
+    closure->operands[0] = compile(args);
+    closure->operands[1] = NULL;
+    closure->function = run_call;
+
+    bool is_single = (args != NULL && args->kind == AST_VALUE_LIST && args->value_list.next == NULL &&
+                        (args->value_list.first == NULL || args->value_list.first->kind != AST_VALUE_LIST));
+    if(closure->builtin != NULL && is_single) {
+        closure->operands[1] = compile(args->value_list.first);
+        closure->function = run_builtin_call;
+    }
+}
+
+/**
+ * 変換しないノードの子を変換します。
+ */
+static void compile_children(Ast* node)
+{
+    switch(node->kind) {
+        case AST_WHEN:
+            compile(node->when_stmt.cond);
+            compile(node->when_stmt.then_block);
+            compile(node->when_stmt.otherwhen_list);
+            compile(node->when_stmt.other_block);
+            return;
+        case AST_OTHERWHEN:
+            compile(node->otherwhen.cond);
+            compile(node->otherwhen.block);
+            compile(node->otherwhen.next);
+            return;
+        case AST_REPEAT:
+            compile(node->repeat_stmt.collection);
+            compile(node->repeat_stmt.block);
+            return;
+        case AST_REPEAT_UNTIL:
+            compile(node->repeat_until_stmt.cond);
+            compile(node->repeat_until_stmt.block);
+            return;
+        case AST_FUNC_DEF:
+            compile(node->func_def.body);
+            return;
+        case AST_ASSIGN:
+            compile(node->assign.right);
+            if(node->assign.left->kind == AST_ARRAY_ACCESS) compile(node->assign.left->array_access.index);
+            if(node->assign.left->kind == AST_FIELD) compile(node->assign.left->field.object);
+            return;
+        case AST_RETURN:
+            compile(node->return_stmt.expr);
+            return;
+        case AST_YIELD:
+            compile(node->yield_stmt.expr);
+            return;
+        case AST_UNARY:
+            compile(node->unary.expr);
+            return;
+        case AST_FSTRING:
+            compile(node->fstring.parts);
+            return;
+        case AST_FSTRING_PARTS:
+            compile(node->fstring_parts.first);
+            compile(node->fstring_parts.next);
+            return;
+        case AST_ARRAY_ACCESS:
+            compile(node->array_access.index);
+            return;
+        case AST_SLICE:
+            compile(node->slice.index);
+            return;
+        case AST_RANGE:
+            compile(node->range.from);
+            compile(node->range.end);
+            return;
+        case AST_MAP:
+            compile(node->map_literal.previous);
+            compile(node->map_literal.key);
+            compile(node->map_literal.value);
+            return;
+        case AST_FIELD:
+            compile(node->field.object);
+            return;
+        case AST_CACHED:
+            compile(node->cached.expr);
+            return;
+        case AST_UNBOXED:
+            compile(node->unboxed.expr);
+            return;
+        case AST_INLINE:
+            compile(node->inline_call.call);
+            compile(node->inline_call.expr);
+            return;
+        case AST_SWITCH:
+            compile(node->switch_stmt.chain);
+            return;
+        default:
+            return;
+    }
+}
+
+/**
+ * 抽象木を実行用の関数に変換します。
+ * 変換済みのノードは同じ場所を書き換えるため、親の関数からの参照はそのまま使えます。
+ */
+static Closure* compile(Ast* node)
+{
+    if(node == NULL) return NULL;
+    Closure* closure = node->closure;
+    if(closure == NULL) {
+        closure = malloc(sizeof(Closure));
+        if(closure == NULL) {
+            output_error("Runtime Error: Failed to compile AST.\n");
+        }
+        node->closure = closure;
+    }
+    closure->function = run_node;
+    closure->node = node;
+    closure->operands = NULL;
+    closure->count = 0;
+    closure->constant = NULL;
+    closure->name = NULL;
+    closure->hash = 0;
+    closure->builtin = NULL;
+
+    switch(node->kind) {
+        case AST_STATEMENTS:
+            set_operands(closure, 2);
+            closure->operands[0] = compile(node->list.first);
+            closure->operands[1] = compile(node->list.next);
+            closure->function = run_statements;
+            break;
+        case AST_BLOCK:
+            set_operands(closure, 1);
+            closure->operands[0] = compile(node->block.statements);
+            closure->function = run_block;
+            break;
+        case AST_ASSIGN:
+            if(node->assign.left->kind != AST_IDENTIFIER) {
+                compile_children(node);
+                break;
+            }
+            set_operands(closure, 1);
+            closure->operands[0] = compile(node->assign.right);
+            closure->name = node->assign.left->identifier.name;
+            closure->hash = dict_hash(closure->name);
+            closure->function = run_assign;
+            break;
+        case AST_IDENTIFIER:
+            closure->name = node->identifier.name;
+            closure->function = run_identifier;
+            break;
+        case AST_INTEGER:
+            closure->constant = new_int(node->integer.value);
+            closure->function = run_constant;
+            break;
+        case AST_FLOAT:
+            closure->constant = new_float(node->real.value);
+            closure->function = run_constant;
+            break;
+        case AST_BOOL:
+            closure->constant = new_bool(node->boolean.value);
+            closure->function = run_constant;
+            break;
+        case AST_BINOP:
+            compile_binop(closure, node);
+            break;
+        case AST_FUNC_CALL:
+            compile_call(closure, node);
+            break;
+        case AST_VALUE_LIST:
+            set_operands(closure, count_values(node));
+            compile_values(node, closure->operands);
+            closure->function = run_value_list;
+            break;
+        default:
+            compile_children(node);
+            break;
+    }
+    return closure;
+}
+
+/**
+ * 抽象木全体を実行用の関数に変換します。
+ * 変換後はevalが変換した関数で実行します。
+ */
+void compile_closures(Ast* root)
+{
+    compile(root);
+}
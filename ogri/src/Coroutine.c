@@ -0,0 +1,172 @@
+#if defined(__APPLE__)
+#define _XOPEN_SOURCE 600
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "Coroutine.h"
+#include "Output.h"
+
+#if !defined(MAP_NORESERVE)
+#define MAP_NORESERVE 0
+#endif
+#if !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#if defined(__clang__)
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+#define STACK_POOL_SIZE 16  // 再利用するために残しておくスタックの数
+
+struct coroutine {
+    ucontext_t context;
+    ucontext_t caller;
+    coroutine_body body;
+    void* argument;
+    void* stack;
+    size_t stack_size;
+    bool running;
+    bool started;
+    bool finished;
+};
+
+static Coroutine* starting = NULL;
+
+static struct {
+    void* stack;
+    size_t size;
+} stack_pool[STACK_POOL_SIZE];     // 解放したスタック
+static int pooled_stacks = 0;
+
+/**
+ * コルーチンの入口です。本体を実行し終えたら呼び出し元に戻ります。
+ */
+static void entry(void)
+{
+    Coroutine* self = starting;
+    self->body(self->argument);
+    self->finished = true;
+    self->running = false;
+    swapcontext(&self->context, &self->caller);
+}
+
+/**
+ * スタックを確保し、本体を実行できるように準備します。
+ * 同じ大きさの解放したスタックがあれば再利用します。
+ * スタックは使われた分だけ物理メモリを消費し、末尾を越えた場合はガードページで停止します。
+ */
+static void start(Coroutine* self)
+{
+    self->stack = NULL;
+    for(int index = pooled_stacks - 1; index >= 0; index--) {
+        if(stack_pool[index].size != self->stack_size) continue;
+        self->stack = stack_pool[index].stack;
+        stack_pool[index] = stack_pool[--pooled_stacks];
+        break;
+    }
+    if(self->stack == NULL) {
+        self->stack = mmap(NULL, self->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if(self->stack == MAP_FAILED) {
+            output_error("Runtime Error: cannot make coroutine stack...\n");
+        }
+        mprotect(self->stack, (size_t)sysconf(_SC_PAGESIZE), PROT_NONE);
+    }
+    if(getcontext(&self->context) != 0) {
+        output_error("Runtime Error: cannot make coroutine context...\n");
+    }
+    self->context.uc_stack.ss_sp = self->stack;
+    self->context.uc_stack.ss_size = self->stack_size;
+    self->context.uc_link = NULL;
+    makecontext(&self->context, entry, 0);
+}
+
+/**
+ * スタックを解放します。
+ * 決まった数までは、後で作るコルーチンが再利用できるように残しておきます。
+ */
+static void free_stack(Coroutine* self)
+{
+    if(self->stack == NULL) return;
+    if(pooled_stacks < STACK_POOL_SIZE) {
+        stack_pool[pooled_stacks].stack = self->stack;
+        stack_pool[pooled_stacks].size = self->stack_size;
+        pooled_stacks++;
+    } else {
+        munmap(self->stack, self->stack_size);
+    }
+    self->stack = NULL;
+}
+
+/**
+ * コンストラクタです。
+ * スタックは最初に実行するときに確保するため、一度も実行しないコルーチンはスタックを持ちません。
+ */
+Coroutine* new_coroutine(coroutine_body body, void* argument, size_t stack_size)
+{
+    Coroutine* self = malloc(sizeof(Coroutine));
+    if(self == NULL) {
+        output_error("Runtime Error: cannot make coroutine...\n");
+    }
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    self->stack_size = (stack_size + page_size - 1) / page_size * page_size + page_size;
+    self->stack = NULL;
+    self->body = body;
+    self->argument = argument;
+    self->running = false;
+    self->started = false;
+    self->finished = false;
+    return self;
+}
+
+/**
+ * コルーチンを次に中断するか終了するまで実行します。
+ * 終了している場合は偽を返します。
+ */
+bool coroutine_resume(Coroutine* self)
+{
+    if(self->finished) return false;
+    if(self->running) {
+        output_error("Runtime Error: coroutine is already running...\n");
+    }
+    if(!self->started) {
+        start(self);
+        self->started = true;
+    }
+    self->running = true;
+    starting = self;
+    swapcontext(&self->caller, &self->context);
+    if(self->finished) free_stack(self);
+    return !self->finished;
+}
+
+/**
+ * 実行中のコルーチンを中断し、呼び出し元に戻ります。
+ */
+void coroutine_yield(Coroutine* self)
+{
+    self->running = false;
+    swapcontext(&self->context, &self->caller);
+}
+
+/**
+ * コルーチンが実行中であるか判定します。
+ */
+bool coroutine_running(Coroutine* self)
+{
+    return self->running;
+}
+
+/**
+ * メモリ解放を行います。
+ * 中断しているコルーチンは、再開せずにスタックごと破棄します。
+ */
+void coroutine_free(Coroutine* self)
+{
+    free_stack(self);
+    free(self);
+}
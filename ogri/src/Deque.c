@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "Deque.h"
+#include "Object.h"
+#include "Output.h"
+
+#define INIT_CAPACITY 8
+
+/**
+ * エラー文のヘルパー関数です。
+ */
+static void error(const char* string) {
+    output_error("%s\n", string);
+}
+
+/**
+ * 先頭からindex番目の要素がある配列の位置を返します。
+ */
+static int slot(Deque* self, long index)
+{
+    return (int)((self->head + index) & (self->capacity - 1));
+}
+
+/**
+ * 配列が一杯であれば大きさを2倍にし、要素を先頭から並べ直します。
+ */
+static void grow(Deque* self)
+{
+    if(self->count < self->capacity) return;
+    Object** items = malloc(sizeof(Object*) * self->capacity * 2);
+    if(items == NULL) error("Runtime Error: Failed to resize a Deque.\n");
+    for(int index = 0; index < self->count; index++) items[index] = self->items[slot(self, index)];
+    free(self->items);
+    self->items = items;
+    self->capacity *= 2;
+    self->head = 0;
+}
+
+/**
+ * コンストラクタです。
+ */
+Deque* newDeque(void)
+{
+    Deque* self = malloc(sizeof(Deque));
+    if(self == NULL) error("Runtime Error: Failed to make Deque.\n");
+    self->items = malloc(sizeof(Object*) * INIT_CAPACITY);
+    if(self->items == NULL) error("Runtime Error: Failed to make Deque.\n");
+    self->capacity = INIT_CAPACITY;
+    self->head = 0;
+    self->count = 0;
+    return self;
+}
+
+/**
+ * 末尾に値を追加します。
+ */
+void deque_push_back(Deque* self, Object* value)
+{
+    grow(self);
+    self->items[slot(self, self->count)] = value;
+    self->count++;
+}
+
+/**
+ * 先頭に値を追加します。
+ */
+void deque_push_front(Deque* self, Object* value)
+{
+    grow(self);
+    self->head = slot(self, -1);
+    self->items[self->head] = value;
+    self->count++;
+}
+
+/**
+ * 末尾の値を取り除いて返します。空の場合はNULLを返します。
+ */
+Object* deque_pop_back(Deque* self)
+{
+    if(self->count == 0) return NULL;
+    self->count--;
+    return self->items[slot(self, self->count)];
+}
+
+/**
+ * 先頭の値を取り除いて返します。空の場合はNULLを返します。
+ */
+Object* deque_pop_front(Deque* self)
+{
+    if(self->count == 0) return NULL;
+    Object* value = self->items[self->head];
+    self->head = slot(self, 1);
+    self->count--;
+    return value;
+}
+
+/**
+ * 先頭からindex番目の値を返します。範囲外の場合はNULLを返します。
+ */
+Object* deque_at(Deque* self, long index)
+{
+    if(index < 0 || index >= self->count) return NULL;
+    return self->items[slot(self, index)];
+}
+
+/**
+ * 先頭からindex番目の値を変更し、変更できたかどうかを返します。
+ */
+bool deque_set(Deque* self, long index, Object* value)
+{
+    if(index < 0 || index >= self->count) return false;
+    self->items[slot(self, index)] = value;
+    return true;
+}
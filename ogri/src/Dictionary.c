@@ -7,6 +7,7 @@
 #include "Dictionary.h"
 #include "List.h"
 #include "Object.h"
+#include "Output.h"
 
 #define MAGIC_NUMBER 9981
 #define STEP 3
@@ -15,8 +16,7 @@
  * エラー文のヘルパー関数です。
  */
 static void error(const char* string) {
-    fprintf(stderr, "%s\n", string);
-    exit(EXIT_FAILURE);
+    output_error("%s\n", string);
 }
 
 /**
@@ -125,6 +125,15 @@ bool dict_set(Dictionary* self, const char* key, Object* value)
     }
 }
 
+/**
+ * キーのハッシュ値を返します。
+ * dict_index_hashedに渡すために、あらかじめ計算しておく場合に使います。
+ */
+unsigned long dict_hash(const char* key)
+{
+    return hash(key);
+}
+
 /**
  * 辞書からentryを得ます。
  */
@@ -151,6 +160,44 @@ HashEntry dict_get(Dictionary* self, const char* key)
     }
 }
 
+/**
+ * 登録されている識別子の位置を返します。登録されていない場合は-1を返します。
+ * 位置は辞書がリサイズされる(capacityが変わる)まで有効です。
+ */
+long dict_index(Dictionary* self, const char* key)
+{
+    return dict_index_hashed(self, key, hash(key));
+}
+
+/**
+ * dict_hashで計算したハッシュ値を使って、登録されている識別子の位置を返します。
+ */
+long dict_index_hashed(Dictionary* self, const char* key, unsigned long hash_value)
+{
+    long index =  (long) (hash_value % (unsigned long)self->capacity);
+    long start_index = index;
+    while(1) {
+        HashEntry* entry = getRef(self->entries, index);
+        if(entry == NULL) error("Runtime Error: Failed to get Entry.");
+
+        if(entry->status == UNUSED) return -1;
+        if(entry->status == OCCUPIED && strcmp(key, entry->key) == 0) return index;
+
+        index = (index + STEP) % self->capacity;
+        if(index == start_index) return -1;
+    }
+}
+
+/**
+ * dict_indexで得た位置の値を直接書き換えます。
+ */
+void dict_store(Dictionary* self, long index, Object* value)
+{
+    HashEntry* entry = getRef(self->entries, index);
+    if(entry == NULL || entry->status != OCCUPIED) error("Runtime Error: Failed to set Entry.");
+    entry->value = value;
+}
+
 /**
  * 辞書のメモリを解放します。
  */
@@ -3,9 +3,50 @@
 #include <stdbool.h>
 #include "Dictionary.h"
 #include "Environment.h"
+#include "List.h"
+#include "Object.h"
+#include "Output.h"
 
 #define DEFAULT_DICT_CAPACITY 100
 
+static Dictionary* local_names = NULL;      // グローバル以外のスコープで定義されたことのある識別子
+static unsigned long binding_version = 1;   // グローバルの識別子を覚えた場所が無効になるたびに進めます
+
+/**
+ * 識別子がグローバル以外のスコープで定義されたことがあるか判定します。
+ */
+static bool is_local_name(const char* key)
+{
+    return local_names != NULL && dict_index(local_names, key) >= 0;
+}
+
+/**
+ * グローバル以外のスコープで識別子が定義されたことを記録します。
+ * 覚えていたグローバルの識別子を隠し得るため、その名前が初めて定義された場合は世代を進めます。
+ */
+static void add_local_name(const char* key)
+{
+    if(local_names == NULL) local_names = newDict(DEFAULT_DICT_CAPACITY);
+    if(dict_index(local_names, key) >= 0) return;
+    dict_set(local_names, key, NULL);
+    binding_version++;
+}
+
+/**
+ * スコープの辞書に登録します。
+ * グローバルの辞書が大きくなった場合は、登録場所が変わるため世代を進めます。
+ */
+static void store(Environment* self, const char* key, Object* value)
+{
+    int capacity = self->table->capacity;
+    bool existed = dict_set(self->table, key, value);
+    if(self->outer == NULL) {
+        if(self->table->capacity != capacity) binding_version++;
+    } else if(!existed) {
+        add_local_name(key);
+    }
+}
+
 /**
  * コンストラクタです。
  */
@@ -13,11 +54,11 @@ Environment* newEnv(Environment* outer)
 {
     Environment* env = malloc(sizeof(Environment));
     if(env == NULL) {
-        fprintf(stderr, "\nRuntime Error: cannot make environment...\n");
-        exit(EXIT_FAILURE);
+        output_error("\nRuntime Error: cannot make environment...\n");
     }
     env->table = newDict(DEFAULT_DICT_CAPACITY);
     env->outer = outer;
+    env->captured = false;
     return env;
 
 }
@@ -33,12 +74,12 @@ void env_set(Environment* self, const char* key, Object* value)
     while(current != NULL) {
         HashEntry result = dict_get(current->table, key);
         if(result.status == OCCUPIED) {
-            dict_set(current->table, key, value);
+            store(current, key, value);
             return;
         }
         current = current->outer;
     }
-    dict_set(self->table, key, value);
+    store(self, key, value);
 }
 
 /**
@@ -46,7 +87,7 @@ void env_set(Environment* self, const char* key, Object* value)
  */
 void env_define(Environment* self, const char* key, Object* value)
 {
-    dict_set(self->table, key, value);
+    store(self, key, value);
 }
 
 /**
@@ -55,11 +96,10 @@ void env_define(Environment* self, const char* key, Object* value)
 void env_assign(Environment* self, const char* key, Object* value, int line)
 {
     if(self == NULL) {
-        fprintf(stderr, "Runtime Error at %d: %s is not defined...\n", line, key);
-        exit(EXIT_FAILURE);
+        output_error("Runtime Error at %d: %s is not defined...\n", line, key);
     }
     HashEntry result = dict_get(self->table, key);
-    if(result.status == OCCUPIED) dict_set(self->table, key, value);
+    if(result.status == OCCUPIED) store(self, key, value);
     else env_assign(self->outer, key, value, line);
 }
 
@@ -69,14 +109,50 @@ void env_assign(Environment* self, const char* key, Object* value, int line)
 Object* env_get(Environment* self, const char* key, int line)
 {
     if(self == NULL) {
-        fprintf(stderr, "Runtime Error at line %d: %s is not defined...\n", line, key);
-        exit(EXIT_FAILURE);
+        output_error("Runtime Error at line %d: %s is not defined...\n", line, key);
     }
     HashEntry result = dict_get(self->table, key);
     if(result.status == OCCUPIED) return result.value;
     return env_get(self->outer, key, line);
 }
 
+/**
+ * 与えられた識別子からその値を返します。
+ * グローバルで見つかった識別子は登録場所をcacheに覚え、次からはスコープをたどらずに値を返します。
+ * グローバル以外のスコープで定義されたことのある識別子は、スコープによって見つかる場所が変わるため覚えません。
+ */
+Object* env_get_cached(Environment* self, const char* key, InlineCache* cache, int line)
+{
+    if(cache->version == binding_version) return cache->entry->value;
+    for(Environment* current = self; current != NULL; current = current->outer) {
+        long index = dict_index(current->table, key);
+        if(index < 0) continue;
+        HashEntry* entry = getRef(current->table->entries, index);
+        if(current->outer == NULL && !is_local_name(key)) {
+            cache->version = binding_version;
+            cache->entry = entry;
+        }
+        return entry->value;
+    }
+    output_error("Runtime Error at line %d: %s is not defined...\n", line, key);
+}
+
+/**
+ * dict_hashで計算したハッシュ値を使って、スコープに識別子を定義します。
+ * すでにある識別子だった場合は、env_setと同じく値を複製して代入します。
+ */
+void env_set_hashed(Environment* self, const char* key, unsigned long hash, Object* value)
+{
+    for(Environment* current = self; current != NULL; current = current->outer) {
+        long index = dict_index_hashed(current->table, key, hash);
+        if(index >= 0) {
+            dict_store(current->table, index, obj_copy(value));
+            return;
+        }
+    }
+    store(self, key, value);
+}
+
 /**
  * グローバルから現在のスコープまで、識別子が定義されているか判定し、真偽を返します。
  */
@@ -88,6 +164,26 @@ bool env_exists(Environment* self, const char* key)
     return env_exists(self->outer, key);
 }
 
+/**
+ * 識別子が定義されているスコープを返します。定義されていない場合はNULLを返します。
+ */
+Environment* env_owner(Environment* self, const char* key)
+{
+    for(Environment* current = self; current != NULL; current = current->outer) {
+        if(dict_index(current->table, key) >= 0) return current;
+    }
+    return NULL;
+}
+
+/**
+ * 関数などに取り込まれたスコープとその外側に印をつけ、解放されないようにします。
+ */
+void env_capture(Environment* self)
+{
+    for(Environment* current = self; current != NULL && !current->captured; current = current->outer)
+        current->captured = true;
+}
+
 /**
  * メモリ解放を行います。
  */
@@ -1,13 +1,62 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <limits.h>
 #include "Ast.h"
 #include "built_in_functions.h"
+#include "Closure.h"
+#include "Coroutine.h"
+#include "Deque.h"
+#include "Dictionary.h"
 #include "Environment.h"
 #include "Evaluate.h"
+#include "Generator.h"
+#include "Heap.h"
 #include "Iterator.h"
+#include "Jit.h"
 #include "List.h"
+#include "Map.h"
+#include "Memo.h"
+#include "NumberFormat.h"
 #include "Object.h"
+#include "Optimizer.h"
+#include "Output.h"
+#include "Record.h"
+#include "Sequence.h"
+#include "Set.h"
+#include "TypedArray.h"
+
+#define BASE_STACK_SIZE (8 << 20)
+
+#define BACKTRACE_EDGE 10   // バックトレースで先頭と末尾から表示するフレームの数
+#define MAX_DEOPTS 16       // 数値のまま計算するのを諦めるまでに通常の実行に戻る回数
+
+static Interpreter* current_interpreter = NULL;   // ビルトイン関数から関数を呼び出すときに使います
+static unsigned long cache_epoch = 1;   // 再利用している式の値が変わり得るたびに進めます
+
+static Object* eval_inline(Ast*, Environment*, Interpreter*);
+static Object* element_at(Ast*, Object*, Object*);
+
+/**
+ * 呼び出し中の関数を新しいものから順に出力します。
+ * フレームが多い場合は先頭と末尾だけを出力します。
+ */
+static void print_backtrace(CallStack* call_stack)
+{
+    if(call_stack == NULL) return;
+    int depth = getSize(call_stack->frames);
+    if(depth == 0) return;
+
+    fprintf(stderr, "Backtrace (most recent call first):\n");
+    for(int index = depth - 1; index >= 0; index--) {
+        if(depth > BACKTRACE_EDGE * 2 && index == depth - 1 - BACKTRACE_EDGE) {
+            fprintf(stderr, "    ... %d frames omitted ...\n", depth - BACKTRACE_EDGE * 2);
+            index = BACKTRACE_EDGE - 1;
+        }
+        CallFrame* frame = getRef(call_stack->frames, index);
+        fprintf(stderr, "    in %s called at line %d\n", frame->name, frame->line);
+    }
+}
 
 /**
  * エラー文を出力します。
@@ -15,14 +64,25 @@
 static void runtime_error(int line, const char* format, ...)
 {
     va_list args;
+    output_flush();
     fprintf(stderr, "Runtime Error at line %d: ", line);
     va_start(args, format);
     vfprintf(stderr, format, args);
     va_end(args);
     fprintf(stderr, "\n");
+    if(current_interpreter != NULL) print_backtrace(current_interpreter->call_stack);
     exit(EXIT_FAILURE);
 }
 
+/**
+ * 識別子の値を返します。
+ * グローバルの識別子は、識別子ごとに覚えた登録場所から直接取り出します。
+ */
+static Object* lookup(Ast* identifier, Environment* env, int line)
+{
+    return env_get_cached(env, identifier->identifier.name, &identifier->identifier.cache, line);
+}
+
 /**
  * 単一のオブジェクトをリストにラップします。
  */
@@ -34,10 +94,290 @@ static Object* wrap_list(Object* value)
 }
 
 
+/**
+ * ビルトイン関数に渡す引数のリストを作成します。
+ * 新しくリストを作成した場合はis_temporaryを真にします。
+ */
+static List* builtin_arguments(Ast* node, Object* arguments, bool* is_temporary)
+{
+    *is_temporary = false;
+    if(arguments == NULL) return NULL;
+    if(node->func_call.args->kind == AST_VALUE_LIST && node->func_call.args->value_list.next != NULL)
+        return arguments->list;
+    if(node->func_call.args->kind == AST_CONSTANT && arguments->type == LIST)
+        return arguments->list;
+
+    List* args = newList(Object*);
+    add(args, &arguments);
+    *is_temporary = true;
+    return args;
+}
+
+/**
+ * 末尾位置の関数呼び出しを実行します。
+ * 呼び出し先が関数であれば実行せずに末尾呼び出しのオブジェクトを返し、
+ * 呼び出し元の関数から戻った後に実行させます。
+ */
+static Object* eval_tail_call(Ast* node, Environment* env, Interpreter* interpreter)
+{
+    Object* function = lookup(node->func_call.name, env, node->line);
+    // 結果を記録する関数は、呼び出しごとに記録を確かめるため通常どおりに呼び出します。
+    if(function == NULL || function->type != FUNCTION || function->func->is_generator || function->func->memo != NULL)
+        return eval_func_call(node, env, interpreter);
+
+    Object* arguments = NULL;
+    if(node->func_call.args != NULL)
+        arguments = eval(node->func_call.args, env, interpreter);
+    return new_tail_call(function, arguments, node);
+}
+
+/**
+ * 再利用している式の値を全て無効にします。
+ * 関数の実行やリストの変更など、変数への代入以外で値が変わり得るときに呼び出します。
+ */
+void invalidate_caches(void)
+{
+    cache_epoch++;
+}
+
+/**
+ * ループに入った回数を返します。
+ */
+static unsigned long loop_entries(Ast* loop)
+{
+    return (loop->kind == AST_REPEAT) ? loop->repeat_stmt.entries : loop->repeat_until_stmt.entries;
+}
+
+/**
+ * 値を再利用する式を実行します。
+ * 値を求める間に関数などが実行された場合は、その値を再利用しません。
+ */
+static Object* eval_cached(Ast* node, Environment* env, Interpreter* interpreter)
+{
+    Ast* source = node->cached.source;
+    if(source != NULL) {
+        if(source->cached.epoch == cache_epoch) return source->cached.value;
+        return eval(node->cached.expr, env, interpreter);
+    }
+
+    Ast* loop = node->cached.loop;
+    if(loop != NULL && node->cached.epoch == cache_epoch && node->cached.entry == loop_entries(loop))
+        return node->cached.value;
+
+    unsigned long epoch = cache_epoch;
+    Object* value = eval(node->cached.expr, env, interpreter);
+    node->cached.value = value;
+    node->cached.epoch = (epoch == cache_epoch) ? epoch : 0;
+    if(loop != NULL) node->cached.entry = loop_entries(loop);
+    return value;
+}
+
+typedef struct {
+    bool is_float;
+    long integer;
+    double real;
+} Number;
+
+/**
+ * 値が数値であればNumberに変換します。
+ */
+static bool to_number(Object* value, Number* number)
+{
+    if(value == NULL) return false;
+    if(value->type == INTEGER) {
+        number->is_float = false;
+        number->integer = value->integer;
+        return true;
+    }
+    if(value->type == FLOAT) {
+        number->is_float = true;
+        number->real = value->real;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Numberを実数として返します。
+ */
+static double real_of(Number* number)
+{
+    return number->is_float ? number->real : (double)number->integer;
+}
+
+/**
+ * 式を途中の値をオブジェクトにせずに数値のまま計算します。
+ * 数値以外の値が現れた場合や、エラーになる演算の場合は偽を返します。
+ */
+static bool eval_number(Ast* node, Environment* env, Interpreter* interpreter, Number* result)
+{
+    switch(node->kind) {
+        case AST_INTEGER:
+            result->is_float = false;
+            result->integer = node->integer.value;
+            return true;
+        case AST_FLOAT:
+            result->is_float = true;
+            result->real = node->real.value;
+            return true;
+        case AST_IDENTIFIER:
+            // 値を読むだけなので、repeat文のループ変数も複製せずに読み出します。
+            return to_number(lookup(node, env, node->line), result);
+        case AST_UNARY: {
+            if(!eval_number(node->unary.expr, env, interpreter, result)) return false;
+            if(node->unary.opcode == OP_ADD) return true;
+            if(node->unary.opcode != OP_SUB) return false;
+            if(result->is_float) result->real = -result->real;
+            else result->integer = -result->integer;
+            return true;
+        }
+        case AST_BINOP: {
+            Number left, right;
+            if(!eval_number(node->binop.left, env, interpreter, &left)) return false;
+            if(!eval_number(node->binop.right, env, interpreter, &right)) return false;
+            Operator op = node->binop.opcode;
+            if(!left.is_float && !right.is_float) {
+                result->is_float = false;
+                switch(op) {
+                    case OP_ADD: result->integer = left.integer + right.integer; return true;
+                    case OP_SUB: result->integer = left.integer - right.integer; return true;
+                    case OP_MUL: result->integer = left.integer * right.integer; return true;
+                    case OP_DIV:
+                    case OP_MOD:
+                        if(right.integer == 0 || (left.integer == LONG_MIN && right.integer == -1)) return false;
+                        result->integer = (op == OP_DIV) ? left.integer / right.integer : left.integer % right.integer;
+                        return true;
+                    default: return false;
+                }
+            }
+            double left_value = real_of(&left);
+            double right_value = real_of(&right);
+            result->is_float = true;
+            switch(op) {
+                case OP_ADD: result->real = left_value + right_value; return true;
+                case OP_SUB: result->real = left_value - right_value; return true;
+                case OP_MUL: result->real = left_value * right_value; return true;
+                case OP_DIV:
+                    if(right_value == 0) return false;
+                    result->real = left_value / right_value;
+                    return true;
+                default: return false;
+            }
+        }
+        case AST_ARRAY_ACCESS: {
+            // 型付き配列の要素は、オブジェクトを作らずに取り出します。
+            Number index;
+            if(!eval_number(node->array_access.index, env, interpreter, &index) || index.is_float) return false;
+            Object* list = lookup(node->array_access.identifier, env, node->line);
+            if(!is_typed_array(list) || index.integer < 0 || index.integer >= list->array->length)
+                return to_number(element_at(node, list, new_int(index.integer)), result);
+            result->is_float = (list->type == FLOAT_ARRAY);
+            if(result->is_float) result->real = list->array->reals[index.integer];
+            else result->integer = list->array->integers[index.integer];
+            return true;
+        }
+        default:
+            return to_number(eval(node, env, interpreter), result);
+    }
+}
+
+/**
+ * 数値の比較を実行します。
+ */
+static bool compare_numbers(Operator op, Number* left, Number* right)
+{
+    if(!left->is_float && !right->is_float) {
+        long a = left->integer, b = right->integer;
+        switch(op) {
+            case OP_EQ: return a == b;
+            case OP_NE: return a != b;
+            case OP_LT: return a < b;
+            case OP_GT: return a > b;
+            case OP_LE: return a <= b;
+            default:    return a >= b;
+        }
+    }
+    double a = real_of(left), b = real_of(right);
+    switch(op) {
+        case OP_EQ: return a == b;
+        case OP_NE: return a != b;
+        case OP_LT: return a < b;
+        case OP_GT: return a > b;
+        case OP_LE: return a <= b;
+        default:    return a >= b;
+    }
+}
+
+/**
+ * 数値のまま計算すると推論した式を実行します。
+ * 何度も実行した式は機械語に変換して実行します。
+ * 数値以外の値が現れた場合は、式を通常どおりに実行し直します。
+ * 何度も実行し直す式は、それ以降は通常どおりに実行します。
+ */
+static Object* eval_unboxed(Ast* node, Environment* env, Interpreter* interpreter)
+{
+    Ast* expr = node->unboxed.expr;
+    if(jit_enabled && node->unboxed.hits < JIT_THRESHOLD && ++node->unboxed.hits == JIT_THRESHOLD)
+        node->unboxed.code = jit_compile(node);
+    if(node->unboxed.code != NULL) {
+        long value;
+        if(jit_run(node->unboxed.code, env, interpreter, &value))
+            return (node->unboxed.type == TYPE_BOOL) ? new_bool(value != 0) : new_int(value);
+        // 整数以外の値が現れた式は、それ以降は機械語を使いません。
+        jit_free(node->unboxed.code);
+        node->unboxed.code = NULL;
+    }
+    if(node->unboxed.deopts < MAX_DEOPTS) {
+        if(node->unboxed.type == TYPE_BOOL) {
+            Number left, right;
+            if(eval_number(expr->binop.left, env, interpreter, &left) &&
+                eval_number(expr->binop.right, env, interpreter, &right))
+                return new_bool(compare_numbers(expr->binop.opcode, &left, &right));
+        } else {
+            Number number;
+            if(eval_number(expr, env, interpreter, &number))
+                return number.is_float ? new_float(number.real) : new_int(number.integer);
+        }
+        node->unboxed.deopts++;
+    }
+    return eval(expr, env, interpreter);
+}
+
+typedef struct {
+    Ast* node;
+    Environment* env;
+    Interpreter* interpreter;
+} Program;
+
+/**
+ * コルーチン上でプログラム全体を実行します。
+ */
+static void run_program(void* argument)
+{
+    Program* program = argument;
+    eval(program->node, program->env, program->interpreter);
+}
+
+/**
+ * 定数を実行します。
+ * リストは変更されても元の定数に影響しないように複製して返します。
+ */
+static Object* eval_constant(Ast* node)
+{
+    Object* value = node->constant.value;
+    if(value->type != LIST) return value;
+
+    List* list = newList(Object*);
+    clone(list, value->list);
+    return new_array(list);
+}
+
 /**
  * 実行します。
+ * 関数呼び出しの深さの上限に合わせた大きさのスタックを用意し、その上で実行します。
+ * optimize_hot_loopsが真の場合は、十分に繰り返された関数の外のループを実行中に最適化します。
  */
-int evaluate(Ast* node)
+int evaluate(Ast* node, int max_depth, bool optimize_hot_loops)
 {
     if(node == NULL) {
         fprintf(stderr, "Runtime Error: no statments...\n");
@@ -45,18 +385,34 @@ int evaluate(Ast* node)
     }
     Environment* env = newEnv(NULL);
     Interpreter* interpreter = malloc(sizeof(Interpreter));
-    if(interpreter == NULL) {
+    CallStack* call_stack = malloc(sizeof(CallStack));
+    if(interpreter == NULL || call_stack == NULL) {
         fprintf(stderr, "Runtime Error: Cannot ready for evaluate...\n");
         return EXIT_FAILURE;
     }
+    call_stack->frames = newList(CallFrame);
+    call_stack->max_depth = max_depth;
+    call_stack->limit = max_depth;
 
     interpreter->loop_level = 0;
-    interpreter->call_stack_depth = 0;
+    interpreter->call_stack = call_stack;
+    interpreter->generator = NULL;
+    interpreter->arguments = NULL;
+    interpreter->program = optimize_hot_loops ? node : NULL;
+    interpreter->hot_loop = NULL;
+    interpreter->iterations = 0;
+    current_interpreter = interpreter;
 
     set_builtins(env);
 
-    eval(node, env, interpreter);
+    Program program = { node, env, interpreter };
+    Coroutine* coroutine = new_coroutine(run_program, &program, BASE_STACK_SIZE + (size_t)max_depth * FRAME_STACK_SIZE);
+    coroutine_resume(coroutine);
+    coroutine_free(coroutine);
 
+    current_interpreter = NULL;
+    dList(call_stack->frames);
+    free(call_stack);
     free(interpreter);
     
     return EXIT_SUCCESS;
@@ -64,10 +420,20 @@ int evaluate(Ast* node)
 
 /**
  * 抽象木を再帰的に探索して実行します。
+ * 実行用の関数に変換した抽象木は、その関数で実行します。
  */
 Object* eval(Ast* node, Environment* env, Interpreter* interpreter)
 {
     if(node == NULL) return NULL;
+    if(node->closure != NULL) return node->closure->function(node->closure, env, interpreter);
+    return eval_node(node, env, interpreter);
+}
+
+/**
+ * 抽象木の種類に応じて実行します。
+ */
+Object* eval_node(Ast* node, Environment* env, Interpreter* interpreter)
+{
     switch(node->kind) {
         case AST_STATEMENTS:
             return eval_statements(node, env, interpreter);
@@ -75,38 +441,38 @@ Object* eval(Ast* node, Environment* env, Interpreter* interpreter)
             return eval_when(node, env, interpreter);
         case AST_OTHERWHEN:
             return eval_otherwhen(node, env, interpreter);
+        case AST_SWITCH:
+            return eval_switch(node, env, interpreter);
         case AST_REPEAT:
             return eval_repeat(node, env, interpreter);
         case AST_REPEAT_UNTIL:
             return eval_repeat_until(node, env, interpreter);
         case AST_FUNC_DEF:
             return eval_func_def(node, env, interpreter);
+        case AST_RECORD_DEF:
+            return eval_record_def(node, env, interpreter);
         case AST_ASSIGN: {
-                Object* value = eval(node->assign.right, env, interpreter);
-                if(node->assign.is_are) {
-                    if(value->type != LIST)
-                        value = wrap_list(value);
-                } else {
-                    bool is_single = (node->assign.left->kind == AST_IDENTIFIER ||
-                                        node->assign.left->kind == AST_ARRAY_ACCESS);
-                    if(is_single && value->type == LIST && getSize(value->list) == 1) {
-                        Object* content;
-                        getAt(value->list, 0, Object*, &content);
-                        dList(value->list);
-                        value = content;
-                    }
-                }
+                Object* value = assigned_value(node, eval(node->assign.right, env, interpreter));
                 Object* result = eval_assign(node->assign.left, value, env, interpreter);
                 return result;
         }
         case AST_RETURN: {
             Object* value = NULL;
-            if(node->return_stmt.expr != NULL)
+            if(node->return_stmt.is_tail_call)
+                value = eval_tail_call(node->return_stmt.expr, env, interpreter);
+            else if(node->return_stmt.expr != NULL)
                 value = eval(node->return_stmt.expr, env, interpreter);
             else 
                 value = new_bool(true);
             return new_result(value);
         }
+        case AST_YIELD: {
+            if(interpreter->generator == NULL)
+                runtime_error(node->line, "yield is only allowed inside a function.\n");
+            Object* value = eval(node->yield_stmt.expr, env, interpreter);
+            generator_yield(interpreter->generator, value);
+            return NULL;
+        }
         case AST_BREAK:
             return new_break();
         case AST_CONTINUE:
@@ -124,9 +490,10 @@ Object* eval(Ast* node, Environment* env, Interpreter* interpreter)
         case AST_UNARY:
             return eval_unary(node, env, interpreter);
         case AST_IDENTIFIER: {
-            Object* value = env_get(env, node->identifier.name, node->line);
+            Object* value = lookup(node, env, node->line);
             if(value == NULL) 
                 runtime_error(node->line, "undefined variable '%s'\n", node->identifier.name);
+            if(value->is_loop_counter) return new_int(value->integer);
             return value;
         }
         case AST_INTEGER:
@@ -135,6 +502,18 @@ Object* eval(Ast* node, Environment* env, Interpreter* interpreter)
             return new_float(node->real.value);
         case AST_STRING:
             return new_string(node->string.value);
+        case AST_BOOL:
+            return new_bool(node->boolean.value);
+        case AST_CONSTANT:
+            return eval_constant(node);
+        case AST_CACHED:
+            return eval_cached(node, env, interpreter);
+        case AST_UNBOXED:
+            return eval_unboxed(node, env, interpreter);
+        case AST_INLINE:
+            return eval_inline(node, env, interpreter);
+        case AST_ARGUMENT:
+            return interpreter->arguments[node->argument.index];
         case AST_FSTRING:
             return eval_fstring(node, env, interpreter);
         case AST_VALUE_LIST:
@@ -143,14 +522,53 @@ Object* eval(Ast* node, Environment* env, Interpreter* interpreter)
             return eval_array_access(node, env, interpreter);
         case AST_SLICE:
             return eval_slice(node, env, interpreter);
+        case AST_MAP:
+            return eval_map(node, env, interpreter);
+        case AST_FIELD:
+            return eval_field(node, env, interpreter);
         default: return NULL;
     }
 }
 
+/**
+ * 代入文で代入する値を返します。
+ * areでは値をリスト(マップの要素を並べた場合はマップ)にし、isでは要素が1つのリストをその要素にします。
+ * areで変数に新しく作ったリストを代入する場合、要素が全て整数か全て実数であれば型付き配列にします。
+ */
+Object* assigned_value(Ast* node, Object* value)
+{
+    if(node->assign.is_are) {
+        Ast* right = node->assign.right;
+        bool is_new = (right->kind == AST_VALUE_LIST || right->kind == AST_CONSTANT || value->type == SEQUENCE);
+        if(value->type == SEQUENCE)
+            obj_materialize(value);
+        else if(value->type != LIST && !is_typed_array(value) && value->type != RANGE && value->type != MAP) {
+            value = wrap_list(value);
+            is_new = true;
+        }
+        if(is_new && node->assign.left->kind == AST_IDENTIFIER) obj_pack(value);
+    } else {
+        bool is_single = (node->assign.left->kind == AST_IDENTIFIER ||
+                            node->assign.left->kind == AST_ARRAY_ACCESS ||
+                            node->assign.left->kind == AST_FIELD);
+        if(is_single && value->type == LIST && getSize(value->list) == 1) {
+            Object* content;
+            getAt(value->list, 0, Object*, &content);
+            dList(value->list);
+            value = content;
+        } else if(is_single && value->type == RANGE && value->range->length == 1) {
+            value = new_int(value->range->start);
+        } else if(is_single && is_typed_array(value) && value->array->length == 1) {
+            value = typed_at(value, 0);
+        }
+    }
+    return value;
+}
+
 /**
  * 与えられたオブジェクトからその真偽値を返します。
  */
-static bool is_true(Object* object)
+bool is_true(Object* object)
 {
     if(object == NULL) return false;
     switch(object->type) {
@@ -158,6 +576,13 @@ static bool is_true(Object* object)
         case INTEGER:   return object->integer != 0;
         case FLOAT:     return object->real != 0.0;
         case LIST:      return getSize(object->list) > 0;
+        case INT_ARRAY:
+        case FLOAT_ARRAY: return object->array->length > 0;
+        case RANGE:     return object->range->length > 0;
+        case MAP:       return object->map->count > 0;
+        case SET:       return object->set->count > 0;
+        case HEAP:      return heap_size(object->heap) > 0;
+        case DEQUE:     return object->deque->count > 0;
         default:    return true;
     }
 }
@@ -183,34 +608,138 @@ Object* eval_statements(Ast* node, Environment* env, Interpreter* interpreter)
     return result;
 }
 
+/**
+ * 関数の外のループの繰り返しを数え始めます。
+ * 数え始めた場合は真を返し、ループを抜けるときにend_hot_loopを呼び出します。
+ */
+static bool begin_hot_loop(Ast* loop, bool optimized, Interpreter* interpreter)
+{
+    if(interpreter->program == NULL || interpreter->hot_loop != NULL || optimized) return false;
+    if(interpreter->generator != NULL || getSize(interpreter->call_stack->frames) > 0) return false;
+    interpreter->hot_loop = loop;
+    interpreter->iterations = 0;
+    return true;
+}
+
+static void end_hot_loop(bool is_hot_loop, Interpreter* interpreter)
+{
+    if(is_hot_loop) interpreter->hot_loop = NULL;
+}
+
+/**
+ * ループの繰り返しを数えます。
+ * 関数の外のループの中で十分に繰り返した場合は、繰り返しの間で最も外側のループを最適化します。
+ * 関数の中で数えた繰り返しは、呼び出し元のループに戻るまで最適化を待ちます。
+ */
+static void count_iteration(Interpreter* interpreter)
+{
+    if(interpreter->hot_loop == NULL) return;
+    if(++interpreter->iterations < OSR_THRESHOLD) return;
+    if(interpreter->generator != NULL || getSize(interpreter->call_stack->frames) > 0) return;
+    optimize_loop(interpreter->hot_loop, interpreter->program);
+    if(interpreter->hot_loop->closure != NULL) compile_closures(interpreter->hot_loop);
+    interpreter->hot_loop = NULL;
+}
+
+/**
+ * 等差数列のrepeat文を実行します。
+ * 要素のリストを作らずに数え上げ、ループ変数の格納場所を直接書き換えます。
+ * ループ変数には1つの整数を繰り返しごとに書き換えて使い、変数から読み出されたときだけ複製します。
+ * 本体で等差数列が変更されてリストに変換されても、繰り返し始めたときの要素を数え上げます。
+ */
+static Object* eval_counted_repeat(Ast* node, Range* source, Environment* env, Interpreter* interpreter)
+{
+    const char* variable_name = node->repeat_stmt.identifier->identifier.name;
+    Range range = *source;
+    long count = range.length;
+    Object* result = NULL;
+
+    Environment* owner = NULL;
+    long slot = -1;
+    int capacity = 0;
+    Object* counter = new_int(0);
+    counter->is_loop_counter = true;
+
+    interpreter->loop_level++;
+    for(long index = 0; index < count; index++) {
+        count_iteration(interpreter);
+        counter->integer = range_at(&range, index);
+        if(owner == NULL || owner->table->capacity != capacity) {
+            env_set(env, variable_name, counter);
+            owner = env_owner(env, variable_name);
+            slot = dict_index(owner->table, variable_name);
+            capacity = owner->table->capacity;
+        } else {
+            dict_store(owner->table, slot, counter);
+        }
+
+        result = eval(node->repeat_stmt.block, env, interpreter);
+
+        if(result != NULL) {
+            if(result->type == BREAK) {
+                result = NULL;
+                break;
+            }
+            if (result->type == CONTINUE) {
+                result = NULL;
+                continue;
+            }
+            if (result->type == RETURN) {
+                break;
+            }
+        }
+    }
+    interpreter->loop_level--;
+
+    return result;
+}
+
 /**
  * repeat文を実行します。
  */
 Object* eval_repeat(Ast* node, Environment* env, Interpreter* interpreter)
 {
+    node->repeat_stmt.entries++;
+    Ast* source = node->repeat_stmt.collection;
+    // ジェネレーター関数を直接呼び出した場合、作られたジェネレーターはこのループからしか参照されません。
+    bool is_temporary_generator = false;
+    if(source->kind == AST_VALUE_LIST && source->value_list.next == NULL)
+        source = source->value_list.first;
+    if(source->kind == AST_FUNC_CALL) {
+        Object* function = lookup(source->func_call.name, env, source->line);
+        is_temporary_generator = function != NULL && function->type == FUNCTION &&
+                                 function->func->is_generator && function->func->memo == NULL;
+    }
     Object* collection = eval(node->repeat_stmt.collection, env, interpreter);
 
     if(collection == NULL)
         runtime_error(node->line, "repeat..foreach requires a list.\n");
 
-    List* target = NULL;
-    bool is_temporary_list = false;
+    bool is_hot_loop = begin_hot_loop(node, node->repeat_stmt.optimized, interpreter);
+    if(collection->type == RANGE) {
+        Object* result = eval_counted_repeat(node, collection->range, env, interpreter);
+        end_hot_loop(is_hot_loop, interpreter);
+        return result;
+    }
 
-    if (collection->type == LIST) {
-        target = collection->list;
-    } else {
-        target = newList(Object*);
-        add(target, &collection);
+    bool is_temporary_list = false;
+    if(collection->type == MAP || collection->type == SET) {
+        // 繰り返し中に変更されても影響しないよう、キーや要素のリストを作ってから繰り返します。
+        collection = new_array((collection->type == MAP) ? map_keys(collection->map) : set_items(collection->set));
+        is_temporary_list = true;
+    } else if(!is_iterable(collection)) {
+        collection = wrap_list(collection);
         is_temporary_list = true;
     }
 
     const char* variable_name = node->repeat_stmt.identifier->identifier.name;
     Object* result = NULL;
 
-    Iterator* iterator = newIterator(new_array(target));
+    Iterator* iterator = newIterator(collection);
     interpreter->loop_level++;
 
     while(has_next(iterator)) {
+        count_iteration(interpreter);
         Object* item = next(iterator);
         env_set(env, variable_name, item);
 
@@ -230,10 +759,12 @@ Object* eval_repeat(Ast* node, Environment* env, Interpreter* interpreter)
             }
         }
     }
-    free(iterator);
-    if(is_temporary_list)
-        dList(target);
+    dIterator(iterator);
+    // 途中で抜けた場合も、このループだけが使っていたジェネレーターはスタックごと解放します。
+    if(is_temporary_list || (is_temporary_generator && collection->type == GENERATOR))
+        obj_free(collection);
     interpreter->loop_level--;
+    end_hot_loop(is_hot_loop, interpreter);
 
     return result;
 }
@@ -244,8 +775,11 @@ Object* eval_repeat(Ast* node, Environment* env, Interpreter* interpreter)
 Object* eval_repeat_until(Ast* node, Environment* env, Interpreter* interpreter)
 {
     Object* result = NULL;
+    node->repeat_until_stmt.entries++;
+    bool is_hot_loop = begin_hot_loop(node, node->repeat_until_stmt.optimized, interpreter);
     interpreter->loop_level++;
     while(1) {
+        count_iteration(interpreter);
         Object* condition = eval(node->repeat_until_stmt.cond, env, interpreter);
 
         if(is_true(condition)) break;
@@ -266,6 +800,7 @@ Object* eval_repeat_until(Ast* node, Environment* env, Interpreter* interpreter)
             }
         }
     }
+    end_hot_loop(is_hot_loop, interpreter);
     return result;
 }
 
@@ -276,7 +811,9 @@ Object* eval_block(Ast* node, Environment* env, Interpreter* interpreter)
 {
     if(node == NULL || node->block.statements == NULL) return NULL;
     Environment* newScope = newEnv(env);
-    return eval(node->block.statements, newScope, interpreter);
+    Object* result = eval(node->block.statements, newScope, interpreter);
+    if(!newScope->captured) env_free(newScope);
+    return result;
 }
 
 /**
@@ -302,10 +839,12 @@ Object* eval_when(Ast* node, Environment* env, Interpreter* interpreter)
 
 /**
  * otherwise_when文を実行します。
+ * 末尾のotherwiseはブロックとして連なっています。
  */
 Object* eval_otherwhen(Ast* node, Environment* env, Interpreter* interpreter)
 {
     if(node == NULL) return NULL;
+    if(node->kind == AST_BLOCK) return eval_block(node, env, interpreter);
 
     Object* condition = eval(node->otherwhen.cond, env, interpreter);
 
@@ -317,6 +856,25 @@ Object* eval_otherwhen(Ast* node, Environment* env, Interpreter* interpreter)
     return NULL;
 }
 
+/**
+ * 分岐表で実行するwhen文を実行します。
+ * 変数の値を1回だけ求めて分岐表から実行するブロックを探します。
+ * 値の型が分岐の値の型と異なる場合は、比較の結果が変わらないように元のwhen文を実行します。
+ */
+Object* eval_switch(Ast* node, Environment* env, Interpreter* interpreter)
+{
+    Ast* subject = node->switch_stmt.subject;
+    Object* value = lookup(subject, env, subject->line);
+    bool is_string = node->switch_stmt.is_string;
+    if(value->type != (is_string ? STRING : INTEGER))
+        return eval_when(node->switch_stmt.chain, env, interpreter);
+
+    SwitchCase* entry = is_string ? switch_case_of(node, 0, value->string) : switch_case_of(node, value->integer, NULL);
+    if(entry != NULL && entry->block != NULL)
+        return eval(entry->block, env, interpreter);
+    return eval(node->switch_stmt.other, env, interpreter);
+}
+
 /**
  * 論理式を実行します。
  */
@@ -343,7 +901,14 @@ Object* eval_binop(Ast* node, Environment* env, Interpreter* interpreter)
 {
     Object* left = eval(node->binop.left, env, interpreter);
     Object* right = eval(node->binop.right, env, interpreter);
+    return apply_binop(node, left, right);
+}
 
+/**
+ * 評価済みの値に二項演算を適用します。
+ */
+Object* apply_binop(Ast* node, Object* left, Object* right)
+{
     const char* op = node->binop.op;
 
     if (left->type == STRING && right->type == STRING) {
@@ -351,9 +916,16 @@ Object* eval_binop(Ast* node, Environment* env, Interpreter* interpreter)
         if (strcmp(op, "!=") == 0) return new_bool(strcmp(left->string, right->string) != 0);
         
         if (strcmp(op, "+") == 0) {
-            char buf[1<<16];
-            snprintf(buf, sizeof(buf), "%s%s", left->string, right->string);
-            return new_string(buf);
+            size_t left_length = strlen(left->string);
+            size_t right_length = strlen(right->string);
+            char* buf = malloc(left_length + right_length + 1);
+            if(buf == NULL)
+                runtime_error(node->line, "Failed to make String.\n");
+            memcpy(buf, left->string, left_length);
+            memcpy(buf + left_length, right->string, right_length + 1);
+            Object* result = new_string(buf);
+            free(buf);
+            return result;
         }
     
         runtime_error(node->line, "Operator '%s' is not supported for strings.\n", op);
@@ -428,21 +1000,49 @@ Object* eval_binop(Ast* node, Environment* env, Interpreter* interpreter)
  */
 static void assign_recursive(Ast* node, Object* list, int* index, Environment* env)
 {
-    if(node == NULL || list->type != LIST) return;
+    if(node == NULL || (list->type != LIST && !is_typed_array(list))) return;
 
     if(node->kind == AST_IDENTIFIER_LIST) {
         assign_recursive(node->identifier_list.first, list, index, env);
         assign_recursive(node->identifier_list.next, list, index, env);
     } else if(node->kind == AST_IDENTIFIER) {
         Object* value;
-        LIST_ERROR getErr = getAt(list->list, *index, Object*, &value);
-        if(getErr != LIST_OK)
+        bool found = is_typed_array(list) ? (value = typed_at(list, *index)) != NULL
+                                          : getAt(list->list, *index, Object*, &value) == LIST_OK;
+        if(!found)
             runtime_error(node->line, "Failed to assign to '%s'\n", node->identifier.name);
         env_set(env, node->identifier.name, value);
         (*index)++;
     }
 }
 
+/**
+ * フィールドへのアクセスの対象のレコードを返します。
+ */
+static Record* field_record(Ast* node, Environment* env, Interpreter* interpreter)
+{
+    Object* object = eval(node->field.object, env, interpreter);
+    if(object == NULL || object->type != RECORD)
+        runtime_error(node->line, "'%s' requires a record.\n", node->field.name->identifier.name);
+    return object->record;
+}
+
+/**
+ * レコードのフィールドの位置を返します。
+ * 直前にアクセスしたレコードと同じ形であれば、覚えておいた位置を使います。
+ */
+static int field_slot(Ast* node, Record* record)
+{
+    if(record->shape == node->field.shape) return node->field.slot;
+    int slot = shape_slot(record->shape, node->field.name->identifier.name);
+    if(slot < 0)
+        runtime_error(node->line, "Record '%s' has no field '%s'.\n",
+                        record->shape->name, node->field.name->identifier.name);
+    node->field.shape = record->shape;
+    node->field.slot = slot;
+    return slot;
+}
+
 /**
  * 代入文を実行します。
  */
@@ -454,8 +1054,15 @@ Object* eval_assign(Ast* node, Object* obj, Environment* env, Interpreter* inter
             env_set(env, node->identifier.name, obj);
             return obj;
         case AST_ARRAY_ACCESS: {
-            Object* list = env_get(env, node->array_access.identifier->identifier.name, node->line);
+            Object* list = lookup(node->array_access.identifier, env, node->line);
             Object* index = eval(node->array_access.index, env, interpreter);
+            if(list->type == RANGE || list->type == SEQUENCE || is_typed_array(list)) obj_prepare_store(list, obj);
+            invalidate_caches();
+            if(is_typed_array(list) && index->type == INTEGER) {
+                if(!typed_set(list, index->integer, obj))
+                    runtime_error(node->line, "Index out of range.\n");
+                return obj;
+            }
             if(list->type == LIST && index->type == INTEGER) {
                 LIST_ERROR setErr = setAt(list->list, (int)index->integer, Object*, &obj);
                 if(setErr != LIST_OK) 
@@ -463,11 +1070,29 @@ Object* eval_assign(Ast* node, Object* obj, Environment* env, Interpreter* inter
 
                 return obj;
             }
+            if(list->type == DEQUE && index->type == INTEGER) {
+                if(!deque_set(list->deque, index->integer, obj))
+                    runtime_error(node->line, "Index out of range.\n");
+                return obj;
+            }
+            if(list->type == MAP) {
+                if(!map_is_key(index))
+                    runtime_error(node->line, "Map key must be a string or a number.\n");
+                map_set(list->map, index, obj);
+                return obj;
+            }
             break;
         }
+        case AST_FIELD: {
+            Record* record = field_record(node, env, interpreter);
+            invalidate_caches();
+            record->slots[field_slot(node, record)] = obj;
+            return obj;
+        }
 
         case AST_IDENTIFIER_LIST: {
             int index = 0;
+            if(obj->type == RANGE || obj->type == SEQUENCE) obj_materialize(obj);
             assign_recursive(node, obj, &index, env);
             return obj;
         }
@@ -481,58 +1106,102 @@ Object* eval_assign(Ast* node, Object* obj, Environment* env, Interpreter* inter
  */
 Object* eval_func_def(Ast* node, Environment* env, Interpreter* interpreter)
 {
+    env_capture(env);
     Object* function = new_func(node->func_def.params, node->func_def.body, env);
+    function->func->is_generator = node->func_def.is_generator;
+    if(node->func_def.remember && !node->func_def.is_generator)
+        function->func->memo = newMemo(node->func_def.memo_limit);
     env_set(env, node->func_def.name->identifier.name, function);
     return function;
 }
 
 /**
- * 関数呼び出しを実行します。
+ * レコードの型の宣言を実行し、型の名前に型を束縛します。
+ * 形は最初に実行したときに作り、同じ宣言からは同じ形のレコードを作ります。
  */
-Object* eval_func_call(Ast* node, Environment* env, Interpreter* interpreter)
+Object* eval_record_def(Ast* node, Environment* env, Interpreter* interpreter)
 {
-    Object* function = env_get(env, node->func_call.name->identifier.name, node->line);
-    if(function == NULL || (function->type != FUNCTION && function->type != BUILT_IN_FUNCTION)) 
-        runtime_error(node->line, "'%s' is not a function.\n", node->func_call.name->identifier.name);
-
-    Object* arguments = NULL;
-    if(node->func_call.args != NULL) 
-        arguments = eval(node->func_call.args, env, interpreter);
-
-    if(function->type == BUILT_IN_FUNCTION) {
-        List* args = NULL;
-        bool tmp_list = false;
-        if(arguments == NULL) {
-            return function->b_func(NULL);
-        }
-        if(node->func_call.args->kind == AST_VALUE_LIST && node->func_call.args->value_list.next != NULL) {
-                args = arguments->list;
-        } else {
-            args = newList(Object*);
-            add(args, &arguments);
-            tmp_list = true;
+    (void)interpreter;
+    if(node->record_def.shape == NULL) {
+        int field_count = 0;
+        for(Ast* item = node->record_def.fields; item != NULL; field_count++)
+            item = (item->kind == AST_IDENTIFIER_LIST) ? item->identifier_list.next : NULL;
+
+        const char** fields = malloc(sizeof(const char*) * field_count);
+        if(fields == NULL)
+            runtime_error(node->line, "Failed to make record '%s'.\n", node->record_def.name->identifier.name);
+        Ast* item = node->record_def.fields;
+        for(int index = 0; index < field_count; index++) {
+            Ast* field = (item->kind == AST_IDENTIFIER_LIST) ? item->identifier_list.first : item;
+            for(int other = 0; other < index; other++)
+                if(strcmp(fields[other], field->identifier.name) == 0)
+                    runtime_error(node->line, "Duplicate field '%s' in record '%s'.\n",
+                                    field->identifier.name, node->record_def.name->identifier.name);
+            fields[index] = field->identifier.name;
+            if(item->kind == AST_IDENTIFIER_LIST) item = item->identifier_list.next;
         }
-        Object* result = function->b_func(args);
-        if (tmp_list) dList(args);
-        return result;
-        
+        node->record_def.shape = newShape(node->record_def.name->identifier.name, field_count, fields);
     }
-        
-    Environment* local = newEnv(function->func->env);
+    Object* type = new_record_type(node->record_def.shape);
+    env_set(env, node->record_def.name->identifier.name, type);
+    return type;
+}
+
+/**
+ * 引数をフィールドの値とするレコードを作成します。
+ * 関数の呼び出しと同じく、リストの引数は各フィールドに順に割り当てます。
+ */
+static Object* construct_record(Shape* shape, Object* arguments, int line)
+{
+    Record* record = newRecord(shape);
+    int count = 0;
+    if(arguments != NULL && arguments->type == RANGE && shape->field_count != 1) obj_materialize(arguments);
+    if(arguments == NULL) {
+        count = 0;
+    } else if((arguments->type != LIST && !is_typed_array(arguments)) || shape->field_count == 1) {
+        record->slots[0] = arguments;
+        count = 1;
+    } else if(is_typed_array(arguments)) {
+        count = (int)arguments->array->length;
+        for(int index = 0; index < count && index < shape->field_count; index++)
+            record->slots[index] = typed_at(arguments, index);
+    } else {
+        count = getSize(arguments->list);
+        for(int index = 0; index < count && index < shape->field_count; index++)
+            getAt(arguments->list, index, Object*, &record->slots[index]);
+    }
+    if(count != shape->field_count)
+        runtime_error(line, "Record '%s' requires %d fields.\n", shape->name, shape->field_count);
+    return new_record(record);
+}
 
-    Ast* params = function->func->params;
+/**
+ * レコードのフィールドの値を返します。
+ */
+Object* eval_field(Ast* node, Environment* env, Interpreter* interpreter)
+{
+    Record* record = field_record(node, env, interpreter);
+    return record->slots[field_slot(node, record)];
+}
 
+/**
+ * 関数の仮引数に実引数を束縛します。
+ */
+static void bind_arguments(Environment* local, Ast* params, Object* arguments, int line, const char* name)
+{
     if(arguments != NULL) {
-        if(arguments->type == LIST) {
-            int argc = getSize(arguments->list);
+        if(arguments->type == RANGE) obj_materialize(arguments);
+        if(arguments->type == LIST || is_typed_array(arguments)) {
+            int argc = is_typed_array(arguments) ? (int)arguments->array->length : getSize(arguments->list);
             for(int index = 0; index < argc; index++) {
                 if(params == NULL) break;
                 Ast* current = (params->kind == AST_IDENTIFIER_LIST) ? params->identifier_list.first : params;
                 
                 Object* value;
-                LIST_ERROR getErr = getAt(arguments->list, index, Object*, &value);
-                if(getErr != LIST_OK) 
-                    runtime_error(node->line, "Failed to function '%s' call.\n", node->func_call.name->identifier.name);
+                if(is_typed_array(arguments))
+                    value = typed_at(arguments, index);
+                else if(getAt(arguments->list, index, Object*, &value) != LIST_OK) 
+                    runtime_error(line, "Failed to function '%s' call.\n", name);
             
                 env_define(local, current->identifier.name, value);
                 if(params->kind == AST_IDENTIFIER_LIST)
@@ -548,15 +1217,171 @@ Object* eval_func_call(Ast* node, Environment* env, Interpreter* interpreter)
             }
         }
     }
+}
 
-    interpreter->call_stack_depth++;
-    Object* result = eval(function->func->block, local, interpreter);
-    interpreter->call_stack_depth--;
+/**
+ * 呼び出す関数のフレームを積み、積んだ後の深さを返します。
+ */
+static int push_frame(CallStack* call_stack, const char* name, int line)
+{
+    CallFrame frame = { name, line };
+    if(getSize(call_stack->frames) >= call_stack->limit) {
+        if(call_stack->limit < call_stack->max_depth)
+            runtime_error(line, "Maximum call depth in a generator (%d) exceeded in '%s'.\n", GENERATOR_MAX_DEPTH, name);
+        runtime_error(line, "Maximum call depth (%d) exceeded in '%s'.\n", call_stack->max_depth, name);
+    }
+    add(call_stack->frames, &frame);
+    return getSize(call_stack->frames);
+}
+
+/**
+ * 関数オブジェクトに引数を束縛して本体を実行します。
+ * 本体が末尾呼び出しを返した場合は、同じ場所で呼び出し先を続けて実行します。
+ * 結果を記録する関数は、同じ値の引数で呼び出された結果があればそれを返します。
+ */
+static Object* call_function(Object* function, Object* arguments, int line, const char* name, Interpreter* interpreter)
+{
+    Memo* memo = function->func->memo;
+    Object* remembered;
+    if(memo != NULL && memo_get(memo, arguments, &remembered)) return remembered;
+    Object* first_arguments = arguments;
 
-    if(result != NULL && result->type == RETURN) {
-        Object* result_value = result->result;
-        return result_value;
+    CallStack* call_stack = interpreter->call_stack;
+    int depth = push_frame(call_stack, name, line);
+
+    while(1) {
+        invalidate_caches();
+        Environment* local = newEnv(function->func->env);
+        bind_arguments(local, function->func->params, arguments, line, name);
+
+        if(function->func->is_generator) {
+            env_capture(local);
+            removeAt(call_stack->frames, depth - 1);
+            return new_generator(newGenerator(function->func->block, local, interpreter));
+        }
+
+        Object* result = eval(function->func->block, local, interpreter);
+        if(!local->captured) env_free(local);
+
+        if(result == NULL || result->type != RETURN || result->result == NULL || result->result->type != TAIL_CALL) {
+            removeAt(call_stack->frames, depth - 1);
+            Object* value = (result != NULL && result->type == RETURN) ? result->result : result;
+            if(memo != NULL) memo_set(memo, first_arguments, value);
+            return value;
+        }
+
+        TailCall* tail_call = result->result->tail_call;
+        function = tail_call->function;
+        arguments = tail_call->arguments;
+        line = tail_call->call->line;
+        name = tail_call->call->func_call.name->identifier.name;
+        obj_free(result->result);
+        free(result);
+
+        CallFrame* top = getRef(call_stack->frames, depth - 1);
+        top->name = name;
+        top->line = line;
     }
+}
+
+
+/**
+ * 評価済みの引数で関数を呼び出します。
+ */
+Object* apply_function(Ast* node, Object* function, Object* arguments, Interpreter* interpreter)
+{
+    if(function->type == BUILT_IN_FUNCTION) {
+        bool tmp_list = false;
+        List* args = builtin_arguments(node, arguments, &tmp_list);
+        Object* result = function->b_func(args);
+        if (tmp_list) dList(args);
+        return result;
+    }
+    if(function->type == RECORD_TYPE)
+        return construct_record(function->shape, arguments, node->line);
+
+    return call_function(function, arguments, node->line, node->func_call.name->identifier.name, interpreter);
+}
+
+/**
+ * 関数呼び出しを実行します。
+ */
+Object* eval_func_call(Ast* node, Environment* env, Interpreter* interpreter)
+{
+    Object* function = lookup(node->func_call.name, env, node->line);
+    if(function == NULL || (function->type != FUNCTION && function->type != BUILT_IN_FUNCTION &&
+                            function->type != RECORD_TYPE)) 
+        runtime_error(node->line, "'%s' is not a function.\n", node->func_call.name->identifier.name);
+
+    Object* arguments = NULL;
+    if(node->func_call.args != NULL) 
+        arguments = eval(node->func_call.args, env, interpreter);
+
+    return apply_function(node, function, arguments, interpreter);
+}
+
+/**
+ * 本体を展開した関数呼び出しを実行します。
+ * 呼び出す関数が展開したものと異なる場合や、引数の数が仮引数と合わない場合は通常どおりに呼び出します。
+ */
+static Object* eval_inline(Ast* node, Environment* env, Interpreter* interpreter)
+{
+    Ast* call = node->inline_call.call;
+    Object* function = lookup(call->func_call.name, env, call->line);
+    if(function == NULL || function->type != FUNCTION)
+        return eval_func_call(call, env, interpreter);
+
+    Object* arguments = NULL;
+    if(call->func_call.args != NULL)
+        arguments = eval(call->func_call.args, env, interpreter);
+    if(function->func->block != node->inline_call.body)
+        return apply_function(call, function, arguments, interpreter);
+
+    int argc = node->inline_call.argc;
+    Object* values[MAX_INLINE_ARGUMENTS];
+    if(argc == 1 && arguments != NULL && arguments->type != LIST && arguments->type != RANGE && !is_typed_array(arguments)) {
+        values[0] = arguments;
+    } else if(argc > 1 && arguments != NULL && arguments->type == LIST && getSize(arguments->list) == argc) {
+        for(int index = 0; index < argc; index++)
+            getAt(arguments->list, index, Object*, &values[index]);
+    } else if(argc != 0) {
+        return apply_function(call, function, arguments, interpreter);
+    }
+
+    // エラー時のバックトレースと呼び出しの深さは、通常の呼び出しと同じにします。
+    int depth = push_frame(interpreter->call_stack, call->func_call.name->identifier.name, call->line);
+    Object** saved = interpreter->arguments;
+    interpreter->arguments = values;
+    Object* result = eval(node->inline_call.expr, env, interpreter);
+    interpreter->arguments = saved;
+    removeAt(interpreter->call_stack->frames, depth - 1);
+    return result;
+}
+
+/**
+ * ビルトイン関数から関数オブジェクトを呼び出します。
+ * 引数が1つの場合はその値を、複数の場合はリストを関数呼び出しと同じように渡します。
+ */
+Object* call_object(Object* function, List* args)
+{
+    if(function == NULL || (function->type != FUNCTION && function->type != BUILT_IN_FUNCTION &&
+                            function->type != RECORD_TYPE)) {
+        output_error("Runtime Error: function object is required.\n");
+    }
+    if(function->type == BUILT_IN_FUNCTION)
+        return function->b_func(args);
+
+    int argc = (args == NULL) ? 0 : getSize(args);
+    Object* arguments = NULL;
+    if(argc == 1)
+        getAt(args, 0, Object*, &arguments);
+    else if(argc > 1)
+        arguments = new_array(args);
+
+    Object* result = (function->type == RECORD_TYPE) ?
+                        construct_record(function->shape, arguments, 0) :
+                        call_function(function, arguments, 0, "<function>", current_interpreter);
+    if(argc > 1) free(arguments);
     return result;
 }
 
@@ -624,16 +1449,39 @@ Object* eval_value_list(Ast* node, Environment* env, Interpreter* interpreter)
 }
 
 /**
- * 配列アクセスを実行します。
+ * 配列アクセスで配列からindex番目の要素を取り出します。
  */
-Object* eval_array_access(Ast* node, Environment* env, Interpreter* interpreter)
+static Object* element_at(Ast* node, Object* list, Object* index)
 {
-    Object* index = eval(node->array_access.index, env, interpreter);
+    if(list->type == MAP) {
+        Object* value = map_is_key(index) ? map_get(list->map, index) : NULL;
+        if(value == NULL)
+            runtime_error(node->line, "Key not found in '%s'.\n", node->array_access.identifier->identifier.name);
+        return value;
+    }
+    if(list->type == SEQUENCE) obj_materialize(list);
+    if((list->type != LIST && list->type != RANGE && list->type != DEQUE && !is_typed_array(list)) || index->type != INTEGER) 
+        runtime_error(node->line, "Invalid array access to '%s'.\n", node->array_access.identifier->identifier.name);
 
-    Object* list = env_get(env, node->array_access.identifier->identifier.name, node->line);
+    if(is_typed_array(list)) {
+        Object* value = typed_at(list, index->integer);
+        if(value == NULL)
+            runtime_error(node->line, "Index out of range of '%s'.\n", node->array_access.identifier->identifier.name);
+        return value;
+    }
 
-    if(list->type != LIST || index->type != INTEGER) 
-        runtime_error(node->line, "Invalid array access to '%s'.\n", node->array_access.identifier->identifier.name);
+    if(list->type == DEQUE) {
+        Object* value = deque_at(list->deque, index->integer);
+        if(value == NULL)
+            runtime_error(node->line, "Index out of range of '%s'.\n", node->array_access.identifier->identifier.name);
+        return value;
+    }
+
+    if(list->type == RANGE) {
+        if(index->integer < 0 || index->integer >= list->range->length)
+            runtime_error(node->line, "Index out of range of '%s'.\n", node->array_access.identifier->identifier.name);
+        return new_int(range_at(list->range, index->integer));
+    }
 
 
     Object* result = NULL;
@@ -644,33 +1492,62 @@ Object* eval_array_access(Ast* node, Environment* env, Interpreter* interpreter)
     return result;
 }
 
+/**
+ * 配列アクセスを実行します。
+ */
+Object* eval_array_access(Ast* node, Environment* env, Interpreter* interpreter)
+{
+    Object* index = eval(node->array_access.index, env, interpreter);
+
+    Object* list = lookup(node->array_access.identifier, env, node->line);
+    return element_at(node, list, index);
+}
+
+/**
+ * マップの要素を並べた式を実行し、新しいマップを返します。
+ * 同じキーが複数ある場合は後の値になります。
+ */
+Object* eval_map(Ast* node, Environment* env, Interpreter* interpreter)
+{
+    Object* map = (node->map_literal.previous != NULL) ?
+                    eval_map(node->map_literal.previous, env, interpreter) : new_map(newMap());
+    Object* key = eval(node->map_literal.key, env, interpreter);
+    if(!map_is_key(key))
+        runtime_error(node->line, "Map key must be a string or a number.\n");
+    map_set(map->map, key, eval(node->map_literal.value, env, interpreter));
+    return map;
+}
+
 /**
  * スライスを実行します。
  */
 Object* eval_slice(Ast* node, Environment* env, Interpreter* interpreter)
 {
-    Object* list = env_get(env, node->slice.identifier->identifier.name, node->line);
-    if(list->type != LIST)
+    Object* list = lookup(node->slice.identifier, env, node->line);
+    if(list->type == SEQUENCE) obj_materialize(list);
+    if(list->type != LIST && list->type != RANGE && !is_typed_array(list))
         runtime_error(node->line, "Slice requires a list.\n");
-    List* source = list->list;
-    int source_length = getSize(source);
+    long source_length;
+    if(list->type == RANGE) source_length = list->range->length;
+    else if(is_typed_array(list)) source_length = list->array->length;
+    else source_length = getSize(list->list);
 
-    int start = 0;
-    int end = source_length;
+    long start = 0;
+    long end = source_length;
 
     if(node->slice.index->kind == AST_RANGE) {
         if(node->slice.index->range.from != NULL) {
             Object* from = eval(node->slice.index->range.from, env, interpreter);
-            start = (int)from->integer;
+            start = from->integer;
         }
 
         if(node->slice.index->range.end != NULL) {
             Object* to = eval(node->slice.index->range.end, env, interpreter);
-            end = (int)to->integer;
+            end = to->integer;
         }
     } else {
         Object* index = eval(node->slice.index, env, interpreter);
-        start = (int)index->integer;
+        start = index->integer;
         end = start + 1;
     }
 
@@ -678,8 +1555,16 @@ Object* eval_slice(Ast* node, Environment* env, Interpreter* interpreter)
     if(end > source_length) end = source_length;
     if(start > end) start = end;
 
+    if(list->type == RANGE)
+        return new_range(range_at(list->range, start), list->range->step, end - start);
+    if(list->type == INT_ARRAY)
+        return new_int_array(typed_array_slice(list->array, start, end));
+    if(list->type == FLOAT_ARRAY)
+        return new_float_array(typed_array_slice(list->array, start, end));
+
+    List* source = list->list;
     List* result = newList(Object*);
-    for(int index = start; index < end; index++) {
+    for(int index = (int)start; index < end; index++) {
         Object* item;
         getAt(source, index, Object*, &item);
         add(result, &item);
@@ -687,21 +1572,64 @@ Object* eval_slice(Ast* node, Environment* env, Interpreter* interpreter)
     return new_array(result);
 }
 
+/**
+ * f文字列を組み立てるための伸長可能なバッファです。
+ */
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} StringBuffer;
+
+/**
+ * バッファに少なくともsize文字分の空きを確保し、書き込み位置を返します。
+ */
+static char* buffer_reserve(StringBuffer* buffer, size_t size)
+{
+    if(buffer->capacity - buffer->length <= size) {
+        size_t capacity = buffer->capacity;
+        while(capacity - buffer->length <= size) capacity *= 2;
+        char* data = realloc(buffer->data, capacity);
+        if(data == NULL) {
+            output_error("Runtime Error: Failed to make String.\n");
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    return buffer->data + buffer->length;
+}
+
+/**
+ * バッファの末尾に文字列を追加します。
+ */
+static void buffer_append(StringBuffer* buffer, const char* string)
+{
+    size_t length = strlen(string);
+    memcpy(buffer_reserve(buffer, length), string, length + 1);
+    buffer->length += length;
+}
+
 /**
  * f文字列を再帰的に探索して作成します。
  */
-static void collect_fstring_content(Ast* node, char* buffer, size_t buf_size, Environment* env, Interpreter* interpreter) {
+static void collect_fstring_content(Ast* node, StringBuffer* buffer, Environment* env, Interpreter* interpreter) {
     if (node == NULL) return;
 
     if (node->kind == AST_FSTRING_PARTS) {
-        collect_fstring_content(node->fstring_parts.first, buffer, buf_size, env, interpreter);
-        collect_fstring_content(node->fstring_parts.next, buffer, buf_size, env, interpreter);
+        collect_fstring_content(node->fstring_parts.first, buffer, env, interpreter);
+        collect_fstring_content(node->fstring_parts.next, buffer, env, interpreter);
     } else if (node->kind == AST_FSTRING_TEXT) {
-        strncat(buffer, node->fstring_text.text, buf_size - strlen(buffer) - 1);
+        buffer_append(buffer, node->fstring_text.text);
     } else {
         Object* val = eval(node, env, interpreter);
+        if(val != NULL && (val->type == INTEGER || val->type == FLOAT)) {
+            char* position = buffer_reserve(buffer, NUMBER_BUFFER_SIZE);
+            if(val->type == INTEGER) buffer->length += format_long(position, val->integer);
+            else buffer->length += format_double(position, val->real);
+            return;
+        }
         char* str = obj_toString(val);
-        strncat(buffer, str, buf_size - strlen(buffer) - 1);
+        buffer_append(buffer, str);
         free(str);
     }
 }
@@ -711,7 +1639,12 @@ static void collect_fstring_content(Ast* node, char* buffer, size_t buf_size, En
  */
 Object* eval_fstring(Ast* node, Environment* env, Interpreter* interpreter)
 {
-    char buffer[1 << 16] = "";
-    collect_fstring_content(node->fstring.parts, buffer, sizeof(buffer), env, interpreter);
-    return new_string(buffer);
+    StringBuffer buffer = { malloc(64), 0, 64 };
+    if(buffer.data == NULL)
+        runtime_error(node->line, "Failed to make String.\n");
+    buffer.data[0] = '\0';
+    collect_fstring_content(node->fstring.parts, &buffer, env, interpreter);
+    Object* result = new_string(buffer.data);
+    free(buffer.data);
+    return result;
 }
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "Coroutine.h"
+#include "Environment.h"
+#include "Evaluate.h"
+#include "Generator.h"
+#include "List.h"
+#include "Object.h"
+#include "Output.h"
+
+#define GENERATOR_STACK_SIZE ((1 << 20) + GENERATOR_MAX_DEPTH * FRAME_STACK_SIZE)
+
+/**
+ * コルーチン上で関数の本体を実行します。
+ */
+static void run_body(void* argument)
+{
+    Generator* self = argument;
+    eval(self->block, self->env, &self->interpreter);
+}
+
+/**
+ * コンストラクタです。
+ * 本体は最初の値を要求されるまで実行されず、本体を実行するスタックもそれまで確保しません。
+ */
+Generator* newGenerator(Ast* block, Environment* env, Interpreter* interpreter)
+{
+    Generator* self = malloc(sizeof(Generator));
+    if(self == NULL) {
+        output_error("Runtime Error: cannot make generator...\n");
+    }
+    self->coroutine = new_coroutine(run_body, self, GENERATOR_STACK_SIZE);
+    self->block = block;
+    self->env = env;
+    self->interpreter = *interpreter;
+    self->interpreter.loop_level = 0;
+    self->interpreter.generator = self;
+    self->value = NULL;
+    self->has_value = false;
+    return self;
+}
+
+/**
+ * 次の値があるかどうかその真偽を返します。
+ * 値がまだ計算されていない場合は、次のyieldまで本体を実行します。
+ */
+bool generator_has_next(Generator* self)
+{
+    if(self->has_value) return true;
+    if(coroutine_running(self->coroutine)) {
+        output_error("Runtime Error: generator is already running...\n");
+    }
+    invalidate_caches();
+    // 本体はプログラム本体より小さいスタックで実行するため、そこから呼び出せる深さを制限します。
+    CallStack* call_stack = self->interpreter.call_stack;
+    int limit = call_stack->limit;
+    int depth = getSize(call_stack->frames) + GENERATOR_MAX_DEPTH;
+    if(depth < limit) call_stack->limit = depth;
+    coroutine_resume(self->coroutine);
+    call_stack->limit = limit;
+    return self->has_value;
+}
+
+/**
+ * 次の値を返します。
+ */
+Object* generator_next(Generator* self)
+{
+    if(!generator_has_next(self)) {
+        output_error("Runtime Error: Generator has no next...\n");
+    }
+    self->has_value = false;
+    return self->value;
+}
+
+/**
+ * 値を渡して本体の実行を中断します。
+ */
+void generator_yield(Generator* self, Object* value)
+{
+    self->value = value;
+    self->has_value = true;
+    coroutine_yield(self->coroutine);
+}
+
+/**
+ * デストラクタです。
+ * 最後まで実行していない場合も、本体のスタックを解放します。
+ */
+void dGenerator(Generator* self)
+{
+    if(self == NULL) return;
+    coroutine_free(self->coroutine);
+    free(self);
+}
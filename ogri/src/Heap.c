@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "Heap.h"
+#include "List.h"
+#include "Object.h"
+#include "Output.h"
+#include "TypedArray.h"
+
+/**
+ * エラー文のヘルパー関数です。
+ */
+static void error(const char* string) {
+    output_error("%s\n", string);
+}
+
+/**
+ * コンストラクタです。
+ */
+Heap* newHeap(Object* key_function)
+{
+    Heap* self = malloc(sizeof(Heap));
+    if(self == NULL) error("Runtime Error: Failed to make Heap.\n");
+    self->entries = newList(HeapEntry);
+    self->key_function = key_function;
+    self->pushed = 0;
+    return self;
+}
+
+/**
+ * リストまたは型付き配列であるキーの要素数を返します。
+ */
+static long key_length(Object* key)
+{
+    return is_typed_array(key) ? key->array->length : getSize(key->list);
+}
+
+/**
+ * リストまたは型付き配列であるキーのindex番目の要素を返します。
+ */
+static Object* key_at(Object* key, long index)
+{
+    if(is_typed_array(key)) return typed_at(key, index);
+    Object* item;
+    getAt(key->list, (int)index, Object*, &item);
+    return item;
+}
+
+/**
+ * ヒープのキーにできる値であるか判定します。
+ * 数値、文字列と、それらを要素とするリストをキーにできます。
+ */
+bool heap_is_key(Object* key)
+{
+    if(key == NULL) return false;
+    if(key->type == INTEGER || key->type == FLOAT || key->type == STRING || is_typed_array(key)) return true;
+    if(key->type != LIST) return false;
+    for(int index = 0; index < getSize(key->list); index++) {
+        Object* item;
+        getAt(key->list, index, Object*, &item);
+        if(!heap_is_key(item)) return false;
+    }
+    return true;
+}
+
+/**
+ * 2つのキーを比べ、leftが小さければ負、等しければ0、大きければ正を返します。
+ * リストは先頭の要素から順に比べます。
+ */
+static int compare_keys(Object* left, Object* right)
+{
+    if((left->type == LIST || is_typed_array(left)) && (right->type == LIST || is_typed_array(right))) {
+        long left_size = key_length(left), right_size = key_length(right);
+        for(long index = 0; index < left_size && index < right_size; index++) {
+            int order = compare_keys(key_at(left, index), key_at(right, index));
+            if(order != 0) return order;
+        }
+        return (left_size > right_size) - (left_size < right_size);
+    }
+    if(left->type == STRING && right->type == STRING) return strcmp(left->string, right->string);
+    if(left->type == INTEGER && right->type == INTEGER)
+        return (left->integer > right->integer) - (left->integer < right->integer);
+    if((left->type == INTEGER || left->type == FLOAT) && (right->type == INTEGER || right->type == FLOAT)) {
+        double a = (left->type == FLOAT) ? left->real : (double)left->integer;
+        double b = (right->type == FLOAT) ? right->real : (double)right->integer;
+        return (a > b) - (a < b);
+    }
+    error("Runtime Error: Cannot compare heap keys of different types.");
+    return 0;
+}
+
+/**
+ * 要素aが要素bより先に取り出されるか判定します。
+ */
+static bool before(HeapEntry* a, HeapEntry* b)
+{
+    int order = compare_keys(a->key, b->key);
+    return order < 0 || (order == 0 && a->order < b->order);
+}
+
+/**
+ * 要素を追加します。keyは値を比べるキーです。
+ */
+void heap_push(Heap* self, Object* key, Object* value)
+{
+    HeapEntry entry = {key, value, self->pushed++};
+    if(add(self->entries, &entry) != LIST_OK) error("Runtime Error: Failed to resize a Heap.\n");
+
+    // 追加した位置から親と入れ替えながら上へ移します。
+    int index = getSize(self->entries) - 1;
+    while(index > 0) {
+        int parent = (index - 1) / 2;
+        HeapEntry* upper = getRef(self->entries, parent);
+        if(!before(&entry, upper)) break;
+        *(HeapEntry*)getRef(self->entries, index) = *upper;
+        index = parent;
+    }
+    *(HeapEntry*)getRef(self->entries, index) = entry;
+}
+
+/**
+ * 最も先に取り出される値を返します。空の場合はNULLを返します。
+ */
+Object* heap_peek(Heap* self)
+{
+    HeapEntry* top = getRef(self->entries, 0);
+    return (top == NULL) ? NULL : top->value;
+}
+
+/**
+ * 最も先に取り出される値を取り除いて返します。空の場合はNULLを返します。
+ */
+Object* heap_pop(Heap* self)
+{
+    int size = getSize(self->entries);
+    if(size == 0) return NULL;
+    Object* value = ((HeapEntry*)getRef(self->entries, 0))->value;
+
+    HeapEntry last = *(HeapEntry*)getRef(self->entries, size - 1);
+    removeAt(self->entries, size - 1);
+    size--;
+    if(size == 0) return value;
+
+    // 末尾の要素を先頭に置き、小さい方の子と入れ替えながら下へ移します。
+    int index = 0;
+    while(true) {
+        int child = index * 2 + 1;
+        if(child >= size) break;
+        HeapEntry* smaller = getRef(self->entries, child);
+        if(child + 1 < size) {
+            HeapEntry* right = getRef(self->entries, child + 1);
+            if(before(right, smaller)) {
+                smaller = right;
+                child++;
+            }
+        }
+        if(!before(smaller, &last)) break;
+        *(HeapEntry*)getRef(self->entries, index) = *smaller;
+        index = child;
+    }
+    *(HeapEntry*)getRef(self->entries, index) = last;
+    return value;
+}
+
+/**
+ * 要素の数を返します。
+ */
+int heap_size(Heap* self)
+{
+    return getSize(self->entries);
+}
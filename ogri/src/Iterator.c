@@ -1,8 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include "Deque.h"
 #include "List.h"
 #include "Object.h"
 #include "Iterator.h"
+#include "Generator.h"
+#include "Output.h"
+#include "Sequence.h"
+#include "TypedArray.h"
 
 /**
  * コンストラクタです。
@@ -11,22 +16,41 @@ Iterator* newIterator(Object* list)
 {
     Iterator* self = malloc(sizeof(Iterator));
     if(self == NULL) {
-        fprintf(stderr, "Runtime Error: cannot make iterator...\n");
-        exit(EXIT_FAILURE);
+        output_error("Runtime Error: cannot make iterator...\n");
     }
     self->list = list;
     self->current = -1;
+    self->source = NULL;
+    self->pending = NULL;
+    if(list != NULL && list->type == SEQUENCE)
+        self->source = newIterator(list->sequence->source);
     return self;
 }
 
+/**
+ * デストラクタです。
+ */
+void dIterator(Iterator* self)
+{
+    if(self == NULL) return;
+    dIterator(self->source);
+    free(self);
+}
+
 /**
  * リストの次の値があるかどうかその真偽を返します。
  */
 bool has_next(Iterator* self)
 {
     if(self == NULL || self->list == NULL) return false;
+    if(self->list->type == GENERATOR) return generator_has_next(self->list->generator);
+    if(self->list->type == SEQUENCE) return sequence_has_next(self);
    
-    int size = getSize(self->list->list);
+    long size;
+    if(self->list->type == RANGE) size = self->list->range->length;
+    else if(self->list->type == DEQUE) size = self->list->deque->count;
+    else if(is_typed_array(self->list)) size = self->list->array->length;
+    else size = getSize(self->list->list);
     return size > (self->current + 1);
 }
 
@@ -36,15 +60,24 @@ bool has_next(Iterator* self)
 Object* next(Iterator* self)
 {
     if(!has_next(self)) {
-        fprintf(stderr, "Runtime Error: Iterator has no next...\n");
-        exit(EXIT_FAILURE);
+        output_error("Runtime Error: Iterator has no next...\n");
     }
     self->current++;
+    if(self->list->type == GENERATOR)
+        return generator_next(self->list->generator);
+    if(self->list->type == SEQUENCE)
+        return sequence_next(self);
+    if(self->list->type == RANGE)
+        return new_int(range_at(self->list->range, self->current));
+    if(self->list->type == DEQUE)
+        return deque_at(self->list->deque, self->current);
+    if(is_typed_array(self->list))
+        return typed_at(self->list, self->current);
+
     Object* content;
-    LIST_ERROR getErr = getAt(self->list->list, self->current, Object*, &content);
+    LIST_ERROR getErr = getAt(self->list->list, (int)self->current, Object*, &content);
     if(getErr != LIST_OK || content == NULL) {
-        fprintf(stderr, "Runtime Error: Cannot get next in iterator...\n");
-        exit(EXIT_FAILURE);
+        output_error("Runtime Error: Cannot get next in iterator...\n");
     }
     return content;
 }
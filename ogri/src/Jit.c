@@ -0,0 +1,414 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include "Ast.h"
+#include "Environment.h"
+#include "Evaluate.h"
+#include "Jit.h"
+#include "List.h"
+#include "Object.h"
+#include "Output.h"
+
+bool jit_enabled = true;
+
+/**
+ * 機械語から呼び出され、式の値を整数として返します。
+ * 整数以外の値の場合はfailedを設定します。
+ */
+static long jit_load(JitContext* context, long index)
+{
+    Ast* leaf = context->leaves[index];
+    // 変数は値を読むだけなので、repeat文のループ変数も複製せずに読み出します。
+    Object* value = (leaf->kind == AST_IDENTIFIER)
+        ? env_get_cached(context->env, leaf->identifier.name, &leaf->identifier.cache, leaf->line)
+        : eval(leaf, context->env, context->interpreter);
+    if(value != NULL && value->type == INTEGER) return value->integer;
+    context->failed = 1;
+    return 0;
+}
+
+#if defined(__x86_64__)
+
+typedef struct {
+    unsigned char* data;
+    size_t length;
+    size_t capacity;
+    List* fail_jumps;   // 失敗時の処理へ飛ぶ命令の飛び先を書き込む位置
+    List* leaves;       // 実行時に値を求める式
+    List* variables;    // 値を一時領域に置いた変数の名前
+    int variable_base;  // 変数の値を置く一時領域の先頭
+} Assembler;
+
+/**
+ * 機械語を書き込みます。
+ */
+static void emit(Assembler* assembler, const unsigned char* bytes, size_t length)
+{
+    if(assembler->length + length > assembler->capacity) {
+        size_t capacity = assembler->capacity * 2 + length;
+        unsigned char* data = realloc(assembler->data, capacity);
+        if(data == NULL) {
+            output_error("Runtime Error: Failed to compile expression.\n");
+        }
+        assembler->data = data;
+        assembler->capacity = capacity;
+    }
+    memcpy(assembler->data + assembler->length, bytes, length);
+    assembler->length += length;
+}
+
+static void emit_int32(Assembler* assembler, int32_t value)
+{
+    emit(assembler, (unsigned char*)&value, sizeof(value));
+}
+
+static void emit_int64(Assembler* assembler, int64_t value)
+{
+    emit(assembler, (unsigned char*)&value, sizeof(value));
+}
+
+/**
+ * 失敗時の処理へ条件付きで飛ぶ命令を書き込みます。
+ * 飛び先は最後にまとめて書き込みます。
+ */
+static void emit_fail_jump(Assembler* assembler, unsigned char condition)
+{
+    unsigned char code[] = { 0x0F, condition };
+    emit(assembler, code, sizeof(code));
+    int position = (int)assembler->length;
+    add(assembler->fail_jumps, &position);
+    emit_int32(assembler, 0);
+}
+
+// mov [rsp + 8 * slot], rax
+static void emit_store(Assembler* assembler, int slot)
+{
+    unsigned char code[] = { 0x48, 0x89, 0x84, 0x24 };
+    emit(assembler, code, sizeof(code));
+    emit_int32(assembler, slot * 8);
+}
+
+// mov rcx, rax; mov rax, [rsp + 8 * slot]
+static void emit_load_operands(Assembler* assembler, int slot)
+{
+    unsigned char code[] = { 0x48, 0x89, 0xC1, 0x48, 0x8B, 0x84, 0x24 };
+    emit(assembler, code, sizeof(code));
+    emit_int32(assembler, slot * 8);
+}
+
+static int slots_of(Ast*);
+
+/**
+ * 左辺を一時領域に置いて右辺を計算する場合に必要な一時領域の数を返します。
+ */
+static int operand_slots(Ast* left, Ast* right)
+{
+    int left_slots = slots_of(left);
+    int right_slots = slots_of(right);
+    if(left_slots < 0 || right_slots < 0) return -1;
+    return (left_slots > right_slots + 1) ? left_slots : right_slots + 1;
+}
+
+/**
+ * 式の計算に必要な一時領域の数を返します。
+ * 機械語に変換できない式の場合は-1を返します。
+ */
+static int slots_of(Ast* node)
+{
+    switch(node->kind) {
+        case AST_FLOAT:
+            return -1;
+        case AST_UNARY:
+            if(node->unary.opcode != OP_ADD && node->unary.opcode != OP_SUB) return -1;
+            return slots_of(node->unary.expr);
+        case AST_BINOP: {
+            Operator op = node->binop.opcode;
+            if(op != OP_ADD && op != OP_SUB && op != OP_MUL && op != OP_DIV && op != OP_MOD) return -1;
+            return operand_slots(node->binop.left, node->binop.right);
+        }
+        default:
+            return 0;
+    }
+}
+
+/**
+ * 変数の名前が一時領域に置かれている位置を返します。置かれていなければ-1を返します。
+ */
+static int variable_slot(List* variables, const char* name)
+{
+    for(int index = 0; index < getSize(variables); index++) {
+        const char* current;
+        getAt(variables, index, const char*, &current);
+        if(strcmp(current, name) == 0) return index;
+    }
+    return -1;
+}
+
+/**
+ * 式に含まれる変数の名前を重複なく集めます。
+ */
+static void collect_variables(Ast* node, List* variables)
+{
+    switch(node->kind) {
+        case AST_IDENTIFIER:
+            if(variable_slot(variables, node->identifier.name) < 0) add(variables, &node->identifier.name);
+            return;
+        case AST_UNARY:
+            collect_variables(node->unary.expr, variables);
+            return;
+        case AST_BINOP:
+            collect_variables(node->binop.left, variables);
+            collect_variables(node->binop.right, variables);
+            return;
+        default:
+            return;
+    }
+}
+
+/**
+ * 除算と剰余を書き込みます。0での除算と、結果が表せない除算は失敗とします。
+ */
+static void emit_division(Assembler* assembler, bool is_modulo)
+{
+    unsigned char test_zero[] = { 0x48, 0x85, 0xC9 };                  // test rcx, rcx
+    emit(assembler, test_zero, sizeof(test_zero));
+    emit_fail_jump(assembler, 0x84);                                    // je fail
+    unsigned char check_overflow[] = { 0x48, 0x83, 0xF9, 0xFF,          // cmp rcx, -1
+                                        0x75, 0x13,                     // jne divide
+                                        0x48, 0xBA };                   // mov rdx, LONG_MIN
+    emit(assembler, check_overflow, sizeof(check_overflow));
+    emit_int64(assembler, LONG_MIN);
+    unsigned char compare[] = { 0x48, 0x39, 0xD0 };                     // cmp rax, rdx
+    emit(assembler, compare, sizeof(compare));
+    emit_fail_jump(assembler, 0x84);                                    // je fail
+    unsigned char divide[] = { 0x48, 0x99, 0x48, 0xF7, 0xF9 };          // divide: cqo; idiv rcx
+    emit(assembler, divide, sizeof(divide));
+    if(is_modulo) {
+        unsigned char remainder[] = { 0x48, 0x89, 0xD0 };               // mov rax, rdx
+        emit(assembler, remainder, sizeof(remainder));
+    }
+}
+
+/**
+ * 実行時の関数を呼び出して式の値をraxに求める機械語を書き込みます。
+ */
+static void emit_load(Assembler* assembler, Ast* node)
+{
+    int index = getSize(assembler->leaves);
+    add(assembler->leaves, &node);
+    unsigned char setup[] = { 0x48, 0x89, 0xDF,                         // mov rdi, rbx
+                                0x48, 0xC7, 0xC6 };                     // mov rsi, imm32
+    emit(assembler, setup, sizeof(setup));
+    emit_int32(assembler, index);
+    unsigned char call[] = { 0x48, 0xB8 };                      // mov rax, jit_load
+    emit(assembler, call, sizeof(call));
+    emit_int64(assembler, (int64_t)(intptr_t)jit_load);
+    unsigned char check[] = { 0xFF, 0xD0,                       // call rax
+                                0x83, 0x7B, (unsigned char)offsetof(JitContext, failed), 0x00 };   // cmp dword [rbx + failed], 0
+    emit(assembler, check, sizeof(check));
+    emit_fail_jump(assembler, 0x85);                            // jne fail
+}
+
+/**
+ * 式の値をraxに求める機械語を書き込みます。
+ * slotより前の一時領域は使用中です。
+ */
+static void emit_expression(Assembler* assembler, Ast* node, int slot)
+{
+    switch(node->kind) {
+        case AST_INTEGER: {
+            unsigned char code[] = { 0x48, 0xB8 };                      // mov rax, imm64
+            emit(assembler, code, sizeof(code));
+            emit_int64(assembler, node->integer.value);
+            return;
+        }
+        case AST_UNARY:
+            emit_expression(assembler, node->unary.expr, slot);
+            if(node->unary.opcode == OP_SUB) {
+                unsigned char code[] = { 0x48, 0xF7, 0xD8 };            // neg rax
+                emit(assembler, code, sizeof(code));
+            }
+            return;
+        case AST_BINOP: {
+            emit_expression(assembler, node->binop.left, slot);
+            emit_store(assembler, slot);
+            emit_expression(assembler, node->binop.right, slot + 1);
+            emit_load_operands(assembler, slot);
+            unsigned char add_code[] = { 0x48, 0x01, 0xC8 };            // add rax, rcx
+            unsigned char sub_code[] = { 0x48, 0x29, 0xC8 };            // sub rax, rcx
+            unsigned char mul_code[] = { 0x48, 0x0F, 0xAF, 0xC1 };      // imul rax, rcx
+            switch(node->binop.opcode) {
+                case OP_ADD: emit(assembler, add_code, sizeof(add_code)); break;
+                case OP_SUB: emit(assembler, sub_code, sizeof(sub_code)); break;
+                case OP_MUL: emit(assembler, mul_code, sizeof(mul_code)); break;
+                default: emit_division(assembler, node->binop.opcode == OP_MOD); break;
+            }
+            return;
+        }
+        case AST_IDENTIFIER: {
+            // 式の中で変数の値は変わらないため、2回目以降は最初に求めた値を使います。
+            int variable = variable_slot(assembler->variables, node->identifier.name);
+            if(variable >= 0) {
+                unsigned char code[] = { 0x48, 0x8B, 0x84, 0x24 };      // mov rax, [rsp + slot]
+                emit(assembler, code, sizeof(code));
+                emit_int32(assembler, (assembler->variable_base + variable) * 8);
+                return;
+            }
+            emit_load(assembler, node);
+            add(assembler->variables, &node->identifier.name);
+            emit_store(assembler, assembler->variable_base + getSize(assembler->variables) - 1);
+            return;
+        }
+        default:
+            emit_load(assembler, node);
+            return;
+    }
+}
+
+/**
+ * 比較の結果を0か1としてraxに求める機械語を書き込みます。
+ */
+static void emit_comparison(Assembler* assembler, Ast* node)
+{
+    emit_expression(assembler, node->binop.left, 0);
+    emit_store(assembler, 0);
+    emit_expression(assembler, node->binop.right, 1);
+    emit_load_operands(assembler, 0);
+
+    unsigned char condition;
+    switch(node->binop.opcode) {
+        case OP_EQ: condition = 0x94; break;    // sete
+        case OP_NE: condition = 0x95; break;    // setne
+        case OP_LT: condition = 0x9C; break;    // setl
+        case OP_GT: condition = 0x9F; break;    // setg
+        case OP_LE: condition = 0x9E; break;    // setle
+        default:    condition = 0x9D; break;    // setge
+    }
+    unsigned char code[] = { 0x48, 0x39, 0xC8,                          // cmp rax, rcx
+                                0x0F, condition, 0xC0,                  // setcc al
+                                0x0F, 0xB6, 0xC0 };                     // movzx eax, al
+    emit(assembler, code, sizeof(code));
+}
+
+// add rsp, frame; pop r12; pop rbx; ret
+static void emit_epilogue(Assembler* assembler, int frame)
+{
+    unsigned char restore[] = { 0x48, 0x81, 0xC4 };
+    emit(assembler, restore, sizeof(restore));
+    emit_int32(assembler, frame);
+    unsigned char code[] = { 0x41, 0x5C, 0x5B, 0xC3 };
+    emit(assembler, code, sizeof(code));
+}
+
+/**
+ * 数値のまま計算する式を機械語に変換します。
+ * 整数だけで計算できない式の場合はNULLを返します。
+ * 変換した関数は、成功すると結果を書き込んで1を、整数以外の値が現れた場合やエラーになる演算の場合は0を返します。
+ */
+JitCode* jit_compile(Ast* node)
+{
+    Ast* expr = node->unboxed.expr;
+    bool is_comparison = (node->unboxed.type == TYPE_BOOL);
+    int slots = is_comparison ? operand_slots(expr->binop.left, expr->binop.right) : slots_of(expr);
+    if(slots < 0) return NULL;
+
+    List* variables = newList(const char*);
+    collect_variables(expr, variables);
+    int frame_slots = slots + getSize(variables);
+    dList(variables);
+    // 呼び出し時点で8バイトずれているスタックを、2つのレジスタの退避と合わせて16バイト境界に揃えます。
+    int frame = frame_slots * 8 + ((frame_slots % 2 == 0) ? 8 : 0);
+
+    Assembler assembler = { malloc(256), 0, 256, newList(int), newList(Ast*), newList(const char*), slots };
+    if(assembler.data == NULL) return NULL;
+
+    unsigned char prologue[] = { 0x53,                                  // push rbx
+                                    0x41, 0x54,                         // push r12
+                                    0x48, 0x89, 0xFB,                   // mov rbx, rdi
+                                    0x49, 0x89, 0xF4,                   // mov r12, rsi
+                                    0x48, 0x81, 0xEC };                 // sub rsp, frame
+    emit(&assembler, prologue, sizeof(prologue));
+    emit_int32(&assembler, frame);
+
+    if(is_comparison) emit_comparison(&assembler, expr);
+    else emit_expression(&assembler, expr, 0);
+
+    unsigned char success[] = { 0x49, 0x89, 0x04, 0x24,                // mov [r12], rax
+                                0xB8, 0x01, 0x00, 0x00, 0x00 };         // mov eax, 1
+    emit(&assembler, success, sizeof(success));
+    emit_epilogue(&assembler, frame);
+
+    int fail = (int)assembler.length;
+    unsigned char failure[] = { 0x31, 0xC0 };                           // fail: xor eax, eax
+    emit(&assembler, failure, sizeof(failure));
+    emit_epilogue(&assembler, frame);
+
+    for(int index = 0; index < getSize(assembler.fail_jumps); index++) {
+        int position;
+        getAt(assembler.fail_jumps, index, int, &position);
+        int32_t offset = fail - (position + 4);
+        memcpy(assembler.data + position, &offset, sizeof(offset));
+    }
+
+    JitCode* code = NULL;
+    void* memory = mmap(NULL, assembler.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(memory != MAP_FAILED) {
+        memcpy(memory, assembler.data, assembler.length);
+        if(mprotect(memory, assembler.length, PROT_READ | PROT_EXEC) == 0) {
+            code = malloc(sizeof(JitCode));
+            int count = getSize(assembler.leaves);
+            Ast** leaves = malloc(sizeof(Ast*) * (count > 0 ? count : 1));
+            for(int index = 0; index < count; index++)
+                getAt(assembler.leaves, index, Ast*, &leaves[index]);
+            code->function = (int (*)(JitContext*, long*))memory;
+            code->leaves = leaves;
+            code->memory = memory;
+            code->size = assembler.length;
+        } else {
+            munmap(memory, assembler.length);
+        }
+    }
+    free(assembler.data);
+    dList(assembler.fail_jumps);
+    dList(assembler.leaves);
+    dList(assembler.variables);
+    return code;
+}
+
+#else
+
+/**
+ * x86-64以外では機械語に変換しません。
+ */
+JitCode* jit_compile(Ast* node)
+{
+    (void)node;
+    (void)jit_load;
+    return NULL;
+}
+
+#endif
+
+/**
+ * 機械語に変換した式を実行します。
+ * 整数以外の値が現れた場合などは偽を返します。
+ */
+bool jit_run(JitCode* code, Environment* env, Interpreter* interpreter, long* result)
+{
+    JitContext context = { code->leaves, env, interpreter, 0 };
+    return code->function(&context, result) != 0;
+}
+
+/**
+ * 機械語に変換した式を解放します。
+ */
+void jit_free(JitCode* code)
+{
+    if(code == NULL) return;
+    munmap(code->memory, code->size);
+    free(code->leaves);
+    free(code);
+}
@@ -190,6 +190,13 @@ LIST_ERROR reverse(List* self)
     return LIST_OK;
 }
 
+// 指定した場所のデータへのポインタを得る (容量が変わるまで有効)
+void* getRef(List* self, int index)
+{
+    if(self == NULL || index < 0 || index >= self->size) return NULL;
+    return (char*)self->data + self->data_size * index;
+}
+
 // リストのサイズを得る
 int getSize(List *self)
 {
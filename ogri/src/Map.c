@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "Map.h"
+#include "List.h"
+#include "Object.h"
+#include "Output.h"
+
+#define INIT_CAPACITY 8
+#define EMPTY_SLOT -1
+#define DELETED_SLOT -2
+
+/**
+ * エラー文のヘルパー関数です。
+ */
+static void error(const char* string) {
+    output_error("%s\n", string);
+}
+
+/**
+ * 整数と等しい実数であれば、その整数を設定します。
+ */
+static bool integral(double value, long* integer)
+{
+    if(!(value >= -9223372036854775808.0 && value < 9223372036854775808.0)) return false;
+    if((double)(long)value != value) return false;
+    *integer = (long)value;
+    return true;
+}
+
+/**
+ * 整数のハッシュ値を求めます。
+ */
+static unsigned long hash_integer(unsigned long value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdUL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53UL;
+    value ^= value >> 33;
+    return value;
+}
+
+/**
+ * キーのハッシュ値を求めます。
+ */
+static unsigned long hash_key(Object* key)
+{
+    long integer;
+    switch(key->type) {
+        case INTEGER:
+            return hash_integer((unsigned long)key->integer);
+        case FLOAT: {
+            if(integral(key->real, &integer)) return hash_integer((unsigned long)integer);
+            unsigned long bits;
+            memcpy(&bits, &key->real, sizeof(bits));
+            return hash_integer(bits ^ 0x9E3779B97F4A7C15UL);
+        }
+        default: {
+            unsigned long hash = 14695981039346656037UL;
+            for(const unsigned char* c = (const unsigned char*)key->string; *c != '\0'; c++) {
+                hash ^= *c;
+                hash *= 1099511628211UL;
+            }
+            return hash;
+        }
+    }
+}
+
+/**
+ * 2つのキーが等しいか判定します。
+ * 整数と実数は値が等しければ同じキーとします。
+ */
+static bool equal_key(Object* left, Object* right)
+{
+    if(left->type == STRING || right->type == STRING)
+        return left->type == right->type && strcmp(left->string, right->string) == 0;
+    if(left->type == INTEGER && right->type == INTEGER) return left->integer == right->integer;
+    if(left->type == FLOAT && right->type == FLOAT) return left->real == right->real;
+
+    Object* real = (left->type == FLOAT) ? left : right;
+    Object* integer = (left->type == FLOAT) ? right : left;
+    long value;
+    return integral(real->real, &value) && value == integer->integer;
+}
+
+/**
+ * 大きさを指定して、空の表と要素の配列を確保します。
+ */
+static void allocate(Map* self, int capacity)
+{
+    self->capacity = capacity;
+    self->slots = malloc(sizeof(int) * capacity);
+    self->entries = malloc(sizeof(MapEntry) * capacity);
+    if(self->slots == NULL || self->entries == NULL) error("Runtime Error: Failed to make Map.\n");
+    for(int index = 0; index < capacity; index++) self->slots[index] = EMPTY_SLOT;
+    self->used = 0;
+    self->count = 0;
+}
+
+/**
+ * 要素の番号を表に登録します。
+ */
+static void place(Map* self, int entry)
+{
+    unsigned long mask = (unsigned long)self->capacity - 1;
+    unsigned long index = self->entries[entry].hash & mask;
+    while(self->slots[index] >= 0) index = (index + 1) & mask;
+    self->slots[index] = entry;
+}
+
+/**
+ * 削除した要素を詰め、表を作り直します。
+ * 要素の数に応じて表の大きさを変えます。
+ */
+static void rebuild(Map* self)
+{
+    MapEntry* old_entries = self->entries;
+    int old_used = self->used;
+    int capacity = INIT_CAPACITY;
+    while(capacity * 2 < (self->count + 1) * 3) capacity *= 2;
+
+    free(self->slots);
+    allocate(self, capacity);
+    for(int index = 0; index < old_used; index++) {
+        if(old_entries[index].key == NULL) continue;
+        self->entries[self->used] = old_entries[index];
+        place(self, self->used);
+        self->used++;
+        self->count++;
+    }
+    free(old_entries);
+}
+
+/**
+ * コンストラクタです。
+ */
+Map* newMap(void)
+{
+    Map* self = malloc(sizeof(Map));
+    if(self == NULL) error("Runtime Error: Failed to make Map.\n");
+    allocate(self, INIT_CAPACITY);
+    return self;
+}
+
+/**
+ * マップのキーにできる値であるか判定します。
+ */
+bool map_is_key(Object* key)
+{
+    return key != NULL && (key->type == STRING || key->type == INTEGER || key->type == FLOAT);
+}
+
+/**
+ * キーの要素がある表の位置を返します。なければ-1を返します。
+ */
+static long find(Map* self, Object* key, unsigned long hash)
+{
+    unsigned long mask = (unsigned long)self->capacity - 1;
+    for(unsigned long index = hash & mask; ; index = (index + 1) & mask) {
+        int entry = self->slots[index];
+        if(entry == EMPTY_SLOT) return -1;
+        if(entry >= 0 && self->entries[entry].hash == hash && equal_key(self->entries[entry].key, key))
+            return (long)index;
+    }
+}
+
+/**
+ * キーの値を返します。キーがなければNULLを返します。
+ */
+Object* map_get(Map* self, Object* key)
+{
+    long slot = find(self, key, hash_key(key));
+    return (slot < 0) ? NULL : self->entries[self->slots[slot]].value;
+}
+
+/**
+ * キーに値を設定します。キーがなければ末尾に追加します。
+ */
+void map_set(Map* self, Object* key, Object* value)
+{
+    unsigned long hash = hash_key(key);
+    long slot = find(self, key, hash);
+    if(slot >= 0) {
+        self->entries[self->slots[slot]].value = value;
+        return;
+    }
+    // 削除した要素も表の位置を占めるため、使った要素の数で大きさを判断します。
+    if((self->used + 1) * 3 > self->capacity * 2) rebuild(self);
+
+    MapEntry* entry = &self->entries[self->used];
+    entry->key = (key->type == STRING) ? new_string(key->string) : key;
+    entry->value = value;
+    entry->hash = hash;
+    place(self, self->used);
+    self->used++;
+    self->count++;
+}
+
+/**
+ * キーの要素を削除し、削除したかどうかを返します。
+ */
+bool map_remove(Map* self, Object* key)
+{
+    long slot = find(self, key, hash_key(key));
+    if(slot < 0) return false;
+    self->entries[self->slots[slot]].key = NULL;
+    self->entries[self->slots[slot]].value = NULL;
+    self->slots[slot] = DELETED_SLOT;
+    self->count--;
+    return true;
+}
+
+/**
+ * キーを追加した順に並べたリストを返します。
+ */
+List* map_keys(Map* self)
+{
+    List* keys = newList(Object*);
+    reserve(keys, self->count);
+    for(int index = 0; index < self->used; index++) {
+        if(self->entries[index].key == NULL) continue;
+        add(keys, &self->entries[index].key);
+    }
+    return keys;
+}
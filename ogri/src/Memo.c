@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "Memo.h"
+#include "List.h"
+#include "Object.h"
+#include "Output.h"
+#include "TypedArray.h"
+
+#define INIT_CAPACITY 16
+#define MAX_LOAD_FACTOR 0.75
+
+/**
+ * エラー文のヘルパー関数です。
+ */
+static void error(const char* string) {
+    output_error("%s\n", string);
+}
+
+/**
+ * 値を混ぜ合わせたハッシュ値を返します。
+ */
+static unsigned long mix(unsigned long hash, unsigned long value)
+{
+    hash ^= value + 0x9E3779B97F4A7C15UL + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+/**
+ * 引数の値のハッシュ値を求めます。
+ * 値で比べられない値を含む場合は偽を返します。
+ * 等差数列と型付き配列は同じ要素のリストと同じ値として扱います。
+ */
+static bool hash_value(Object* value, unsigned long* hash)
+{
+    if(value == NULL) {
+        *hash = mix(*hash, NONE);
+        return true;
+    }
+    switch(value->type) {
+        case INTEGER:
+        case BOOL:
+            *hash = mix(*hash, (unsigned long)value->type);
+            *hash = mix(*hash, (value->type == BOOL) ? (unsigned long)value->boolean : (unsigned long)value->integer);
+            return true;
+        case FLOAT: {
+            unsigned long bits;
+            memcpy(&bits, &value->real, sizeof(bits));
+            *hash = mix(mix(*hash, FLOAT), bits);
+            return true;
+        }
+        case STRING:
+            *hash = mix(*hash, STRING);
+            for(const char* c = value->string; *c != '\0'; c++)
+                *hash = mix(*hash, (unsigned char)*c);
+            return true;
+        case LIST: {
+            int size = getSize(value->list);
+            *hash = mix(mix(*hash, LIST), (unsigned long)size);
+            for(int index = 0; index < size; index++) {
+                Object* element;
+                getAt(value->list, index, Object*, &element);
+                if(!hash_value(element, hash)) return false;
+            }
+            return true;
+        }
+        case INT_ARRAY:
+        case FLOAT_ARRAY:
+            *hash = mix(mix(*hash, LIST), (unsigned long)value->array->length);
+            for(long index = 0; index < value->array->length; index++) {
+                if(value->type == INT_ARRAY) {
+                    *hash = mix(mix(*hash, INTEGER), (unsigned long)value->array->integers[index]);
+                } else {
+                    unsigned long bits;
+                    memcpy(&bits, &value->array->reals[index], sizeof(bits));
+                    *hash = mix(mix(*hash, FLOAT), bits);
+                }
+            }
+            return true;
+        case RANGE:
+            *hash = mix(mix(*hash, LIST), (unsigned long)value->range->length);
+            for(long index = 0; index < value->range->length; index++)
+                *hash = mix(mix(*hash, INTEGER), (unsigned long)range_at(value->range, index));
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * 記録した引数と呼び出しの引数が同じ値であるか判定します。
+ * 記録した引数は等差数列と型付き配列を含みません。
+ */
+static bool equal_value(Object* stored, Object* value)
+{
+    if(stored == NULL || value == NULL) return stored == value;
+    if(value->type == RANGE) {
+        if(stored->type != LIST || getSize(stored->list) != value->range->length) return false;
+        for(long index = 0; index < value->range->length; index++) {
+            Object* element;
+            getAt(stored->list, (int)index, Object*, &element);
+            if(element->type != INTEGER || element->integer != range_at(value->range, index)) return false;
+        }
+        return true;
+    }
+    if(is_typed_array(value)) {
+        if(stored->type != LIST || getSize(stored->list) != value->array->length) return false;
+        for(long index = 0; index < value->array->length; index++) {
+            Object* element;
+            getAt(stored->list, (int)index, Object*, &element);
+            if(!equal_value(element, typed_at(value, index))) return false;
+        }
+        return true;
+    }
+    if(stored->type != value->type) return false;
+    switch(value->type) {
+        case INTEGER:   return stored->integer == value->integer;
+        case BOOL:      return stored->boolean == value->boolean;
+        case FLOAT:     return memcmp(&stored->real, &value->real, sizeof(double)) == 0;
+        case STRING:    return strcmp(stored->string, value->string) == 0;
+        case LIST: {
+            int size = getSize(value->list);
+            if(getSize(stored->list) != size) return false;
+            for(int index = 0; index < size; index++) {
+                Object *left, *right;
+                getAt(stored->list, index, Object*, &left);
+                getAt(value->list, index, Object*, &right);
+                if(!equal_value(left, right)) return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * 記録する値を複製します。
+ * リストは呼び出し元で書き換えられても記録が変わらないよう要素ごとに複製し、等差数列と型付き配列はリストにします。
+ * それ以外の値は書き換えられないため、そのまま使います。
+ */
+static Object* copy_value(Object* value)
+{
+    if(value == NULL) return NULL;
+    if(value->type == RANGE) {
+        List* list = newList(Object*);
+        for(long index = 0; index < value->range->length; index++) {
+            Object* element = new_int(range_at(value->range, index));
+            add(list, &element);
+        }
+        return new_array(list);
+    }
+    if(is_typed_array(value)) {
+        List* list = newList(Object*);
+        for(long index = 0; index < value->array->length; index++) {
+            Object* element = typed_at(value, index);
+            add(list, &element);
+        }
+        return new_array(list);
+    }
+    if(value->type != LIST) return value;
+
+    List* list = newList(Object*);
+    for(int index = 0; index < getSize(value->list); index++) {
+        Object* element;
+        getAt(value->list, index, Object*, &element);
+        element = copy_value(element);
+        add(list, &element);
+    }
+    return new_array(list);
+}
+
+/**
+ * コンストラクタです。
+ * limitが0の場合は記録する数に上限を設けません。
+ */
+Memo* newMemo(long limit)
+{
+    Memo* self = malloc(sizeof(Memo));
+    if(self == NULL) error("Runtime Error: Failed to make Memo.\n");
+    self->capacity = INIT_CAPACITY;
+    self->buckets = calloc(self->capacity, sizeof(MemoEntry*));
+    if(self->buckets == NULL) error("Runtime Error: Failed to make Memo.\n");
+    self->count = 0;
+    self->limit = limit;
+    self->newest = NULL;
+    self->oldest = NULL;
+    return self;
+}
+
+/**
+ * 要素を使われた順のリストから外します。
+ */
+static void unlink_entry(Memo* self, MemoEntry* entry)
+{
+    if(entry->newer != NULL) entry->newer->older = entry->older;
+    else self->newest = entry->older;
+    if(entry->older != NULL) entry->older->newer = entry->newer;
+    else self->oldest = entry->newer;
+}
+
+/**
+ * 要素を最も新しく使われたものとして、使われた順のリストに加えます。
+ */
+static void push_newest(Memo* self, MemoEntry* entry)
+{
+    entry->newer = NULL;
+    entry->older = self->newest;
+    if(self->newest != NULL) self->newest->newer = entry;
+    else self->oldest = entry;
+    self->newest = entry;
+}
+
+/**
+ * 最も長く使われていない要素を削除します。
+ */
+static void evict_oldest(Memo* self)
+{
+    MemoEntry* entry = self->oldest;
+    MemoEntry** link = &self->buckets[entry->hash % self->capacity];
+    while(*link != entry) link = &(*link)->next;
+    *link = entry->next;
+    unlink_entry(self, entry);
+    free(entry);
+    self->count--;
+}
+
+/**
+ * バケットの数を2倍にし、要素を振り分け直します。
+ */
+static void resize(Memo* self)
+{
+    int new_capacity = self->capacity * 2;
+    MemoEntry** buckets = calloc(new_capacity, sizeof(MemoEntry*));
+    if(buckets == NULL) error("Runtime Error: Failed to resize a Memo.\n");
+    for(int index = 0; index < self->capacity; index++) {
+        MemoEntry* entry = self->buckets[index];
+        while(entry != NULL) {
+            MemoEntry* next = entry->next;
+            entry->next = buckets[entry->hash % new_capacity];
+            buckets[entry->hash % new_capacity] = entry;
+            entry = next;
+        }
+    }
+    free(self->buckets);
+    self->buckets = buckets;
+    self->capacity = new_capacity;
+}
+
+/**
+ * 引数に対して記録した結果を探します。
+ * 見つかった場合はvalueに結果を設定し、最も新しく使われたものとして真を返します。
+ */
+bool memo_get(Memo* self, Object* arguments, Object** value)
+{
+    unsigned long hash = 0;
+    if(!hash_value(arguments, &hash)) return false;
+    for(MemoEntry* entry = self->buckets[hash % self->capacity]; entry != NULL; entry = entry->next) {
+        if(entry->hash != hash || !equal_value(entry->arguments, arguments)) continue;
+        if(entry != self->newest) {
+            unlink_entry(self, entry);
+            push_newest(self, entry);
+        }
+        *value = copy_value(entry->value);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * 引数に対する結果を記録します。
+ * 値で比べられない引数の場合は記録しません。
+ * 上限を超える場合は最も長く使われていない結果を削除します。
+ */
+void memo_set(Memo* self, Object* arguments, Object* value)
+{
+    unsigned long hash = 0;
+    if(!hash_value(arguments, &hash)) return;
+    for(MemoEntry* entry = self->buckets[hash % self->capacity]; entry != NULL; entry = entry->next) {
+        if(entry->hash == hash && equal_value(entry->arguments, arguments)) {
+            entry->value = copy_value(value);
+            return;
+        }
+    }
+
+    if(self->limit > 0 && self->count >= self->limit) evict_oldest(self);
+    if(self->count + 1 > self->capacity * MAX_LOAD_FACTOR) resize(self);
+
+    MemoEntry* entry = malloc(sizeof(MemoEntry));
+    if(entry == NULL) error("Runtime Error: Failed to add to a Memo.\n");
+    entry->arguments = copy_value(arguments);
+    entry->value = copy_value(value);
+    entry->hash = hash;
+    entry->next = self->buckets[hash % self->capacity];
+    self->buckets[hash % self->capacity] = entry;
+    push_newest(self, entry);
+    self->count++;
+}
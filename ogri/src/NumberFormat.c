@@ -0,0 +1,371 @@
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "NumberFormat.h"
+
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS (0x3FF + DP_SIGNIFICAND_SIZE)
+#define DP_MIN_EXPONENT (-DP_EXPONENT_BIAS)
+#define DP_EXPONENT_MASK 0x7FF0000000000000ULL
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DP_HIDDEN_BIT 0x0010000000000000ULL
+
+#define MAX_FIXED_EXPONENT 17     // これ以上の桁数になる場合は指数表記にします
+#define MIN_FIXED_EXPONENT (-4)   // これ未満の桁数になる場合は指数表記にします
+
+typedef struct {
+    uint64_t f;
+    int e;
+} DiyFp;
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const uint64_t pow10_table[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+/**
+ * 10^(-348 + 8i) を正規化した仮数部と2進指数の組です。
+ */
+static const uint64_t cached_powers_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const int16_t cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066
+};
+
+/**
+ * 符号なし整数を10進数で書き込み、書き込んだ文字数を返します。
+ */
+static int format_unsigned(char* buffer, unsigned long value)
+{
+    char tmp[NUMBER_BUFFER_SIZE];
+    char* end = tmp + sizeof(tmp);
+    char* p = end;
+
+    while(value >= 100) {
+        unsigned index = (unsigned)(value % 100) * 2;
+        value /= 100;
+        *--p = digit_pairs[index + 1];
+        *--p = digit_pairs[index];
+    }
+    if(value >= 10) {
+        unsigned index = (unsigned)value * 2;
+        *--p = digit_pairs[index + 1];
+        *--p = digit_pairs[index];
+    } else {
+        *--p = (char)('0' + value);
+    }
+    int length = (int)(end - p);
+    memcpy(buffer, p, length);
+    buffer[length] = '\0';
+    return length;
+}
+
+/**
+ * 整数を10進数で書き込み、書き込んだ文字数を返します。
+ */
+int format_long(char* buffer, long value)
+{
+    if(value < 0) {
+        buffer[0] = '-';
+        return 1 + format_unsigned(buffer + 1, 0UL - (unsigned long)value);
+    }
+    return format_unsigned(buffer, (unsigned long)value);
+}
+
+/**
+ * 2つの仮数部の積の上位64ビットを丸めて返します。
+ */
+static DiyFp diy_multiply(DiyFp x, DiyFp y)
+{
+    const uint64_t mask = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32, b = x.f & mask;
+    uint64_t c = y.f >> 32, d = y.f & mask;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & mask) + (bc & mask);
+    tmp += 1ULL << 31;
+    DiyFp result = { ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
+    return result;
+}
+
+/**
+ * 最上位ビットが立つように正規化します。
+ */
+static DiyFp diy_normalize(DiyFp x)
+{
+    while(!(x.f & (1ULL << 63))) {
+        x.f <<= 1;
+        x.e--;
+    }
+    return x;
+}
+
+/**
+ * 実数の仮数部と指数部を取り出します。
+ */
+static DiyFp diy_from_double(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int biased_e = (int)((bits & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+    uint64_t significand = bits & DP_SIGNIFICAND_MASK;
+    DiyFp result;
+    if(biased_e != 0) {
+        result.f = significand + DP_HIDDEN_BIT;
+        result.e = biased_e - DP_EXPONENT_BIAS;
+    } else {
+        result.f = significand;
+        result.e = DP_MIN_EXPONENT + 1;
+    }
+    return result;
+}
+
+/**
+ * 値の前後の丸め境界を正規化して求めます。
+ */
+static void diy_boundaries(DiyFp value, DiyFp* minus, DiyFp* plus)
+{
+    DiyFp upper = { (value.f << 1) + 1, value.e - 1 };
+    while(!(upper.f & (DP_HIDDEN_BIT << 1))) {
+        upper.f <<= 1;
+        upper.e--;
+    }
+    upper.f <<= (64 - DP_SIGNIFICAND_SIZE - 2);
+    upper.e -= (64 - DP_SIGNIFICAND_SIZE - 2);
+
+    DiyFp lower;
+    if(value.f == DP_HIDDEN_BIT) {
+        lower.f = (value.f << 2) - 1;
+        lower.e = value.e - 2;
+    } else {
+        lower.f = (value.f << 1) - 1;
+        lower.e = value.e - 1;
+    }
+    lower.f <<= lower.e - upper.e;
+    lower.e = upper.e;
+
+    *minus = lower;
+    *plus = upper;
+}
+
+/**
+ * 2進指数に合う10のべき乗を表から選び、その10進指数をKに返します。
+ */
+static DiyFp cached_power(int e, int* K)
+{
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int k = (int)dk;
+    if(dk - k > 0.0) k++;
+
+    unsigned index = (unsigned)((k >> 3) + 1);
+    *K = -(-348 + (int)(index << 3));
+    DiyFp result = { cached_powers_f[index], cached_powers_e[index] };
+    return result;
+}
+
+/**
+ * 最後の桁を真の値に近づくように調整します。
+ */
+static void grisu_round(char* buffer, int length, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+    while(rest < wp_w && delta - rest >= ten_kappa &&
+            (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        buffer[length - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+/**
+ * 32ビット整数の10進桁数を返します。
+ */
+static int count_digits(uint32_t n)
+{
+    int digits = 1;
+    while(digits < 10 && n >= pow10_table[digits]) digits++;
+    return digits;
+}
+
+/**
+ * 境界の間に収まる最短の桁列を生成します。
+ */
+static int digit_gen(DiyFp W, DiyFp Mp, uint64_t delta, char* buffer, int* K)
+{
+    DiyFp one = { 1ULL << -Mp.e, Mp.e };
+    uint64_t wp_w = Mp.f - W.f;
+    uint32_t p1 = (uint32_t)(Mp.f >> -one.e);
+    uint64_t p2 = Mp.f & (one.f - 1);
+    int kappa = count_digits(p1);
+    int length = 0;
+
+    while(kappa > 0) {
+        uint32_t divisor = (uint32_t)pow10_table[kappa - 1];
+        uint32_t d = p1 / divisor;
+        p1 %= divisor;
+        if(d || length) buffer[length++] = (char)('0' + d);
+        kappa--;
+        uint64_t tmp = ((uint64_t)p1 << -one.e) + p2;
+        if(tmp <= delta) {
+            *K += kappa;
+            grisu_round(buffer, length, delta, tmp, pow10_table[kappa] << -one.e, wp_w);
+            return length;
+        }
+    }
+
+    for(;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> -one.e);
+        if(d || length) buffer[length++] = (char)('0' + d);
+        p2 &= one.f - 1;
+        kappa--;
+        if(p2 < delta) {
+            *K += kappa;
+            int index = -kappa;
+            grisu_round(buffer, length, delta, p2, one.f, wp_w * (index < 20 ? pow10_table[index] : 0));
+            return length;
+        }
+    }
+}
+
+/**
+ * 正の有限な実数の最短の桁列を求めます。
+ * 値は 桁列 * 10^K となります。
+ */
+static int grisu2(double value, char* digits, int* K)
+{
+    DiyFp v = diy_from_double(value);
+    DiyFp w_minus, w_plus;
+    diy_boundaries(v, &w_minus, &w_plus);
+
+    DiyFp c_mk = cached_power(w_plus.e, K);
+    DiyFp W = diy_multiply(diy_normalize(v), c_mk);
+    DiyFp Wp = diy_multiply(w_plus, c_mk);
+    DiyFp Wm = diy_multiply(w_minus, c_mk);
+    Wm.f++;
+    Wp.f--;
+    return digit_gen(W, Wp, Wp.f - Wm.f, digits, K);
+}
+
+/**
+ * 桁列を固定小数点または指数表記で書き込みます。
+ */
+static int format_digits(char* buffer, const char* digits, int length, int K)
+{
+    int exponent = length + K - 1;
+    char* p = buffer;
+
+    if(exponent < MIN_FIXED_EXPONENT || exponent >= MAX_FIXED_EXPONENT) {
+        *p++ = digits[0];
+        if(length > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, length - 1);
+            p += length - 1;
+        }
+        *p++ = 'e';
+        *p++ = exponent < 0 ? '-' : '+';
+        if(exponent < 0) exponent = -exponent;
+        if(exponent < 10) *p++ = '0';
+        p += format_unsigned(p, (unsigned long)exponent);
+    } else if(K >= 0) {
+        memcpy(p, digits, length);
+        p += length;
+        memset(p, '0', K);
+        p += K;
+    } else if(exponent >= 0) {
+        memcpy(p, digits, exponent + 1);
+        p += exponent + 1;
+        *p++ = '.';
+        memcpy(p, digits + exponent + 1, length - exponent - 1);
+        p += length - exponent - 1;
+    } else {
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', -exponent - 1);
+        p += -exponent - 1;
+        memcpy(p, digits, length);
+        p += length;
+    }
+    *p = '\0';
+    return (int)(p - buffer);
+}
+
+/**
+ * 実数を元の値に戻せる最短の表現で書き込み、書き込んだ文字数を返します。
+ */
+int format_double(char* buffer, double value)
+{
+    char* p = buffer;
+    if(value != value) {
+        memcpy(buffer, "nan", 4);
+        return 3;
+    }
+    if(signbit(value)) {
+        *p++ = '-';
+        value = -value;
+    }
+    if(value == 0.0) {
+        *p++ = '0';
+        *p = '\0';
+        return (int)(p - buffer);
+    }
+    if(isinf(value)) {
+        memcpy(p, "inf", 4);
+        return (int)(p - buffer) + 3;
+    }
+
+    char digits[NUMBER_BUFFER_SIZE];
+    int K = 0;
+    int length = grisu2(value, digits, &K);
+    return (int)(p - buffer) + format_digits(p, digits, length, K);
+}
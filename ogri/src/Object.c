@@ -1,8 +1,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <limits.h>
+#include "Deque.h"
+#include "Generator.h"
+#include "Heap.h"
+#include "Iterator.h"
 #include "List.h"
+#include "Map.h"
+#include "NumberFormat.h"
 #include "Object.h"
+#include "Output.h"
+#include "Record.h"
+#include "Set.h"
+#include "TypedArray.h"
 
 /**
  * Objectのメモリ確保を行います。
@@ -11,9 +22,9 @@ static Object* new_object()
 {
     Object* object = malloc(sizeof(Object));
     if(object == NULL) {
-        fprintf(stderr, "Runtime Error: Failed to make Object.\n");
-        exit(EXIT_FAILURE);
+        output_error("Runtime Error: Failed to make Object.\n");
     }
+    object->is_loop_counter = false;
     return object;
 }
 
@@ -72,6 +83,135 @@ Object* new_array(List* list)
     return obj;
 }
 
+/**
+ * 整数の型付き配列のオブジェクトを作成します。
+ */
+Object* new_int_array(TypedArray* array)
+{
+    Object* obj = new_object();
+    obj->type = INT_ARRAY;
+    obj->array = array;
+    return obj;
+}
+
+/**
+ * 実数の型付き配列のオブジェクトを作成します。
+ */
+Object* new_float_array(TypedArray* array)
+{
+    Object* obj = new_object();
+    obj->type = FLOAT_ARRAY;
+    obj->array = array;
+    return obj;
+}
+
+/**
+ * 等差数列のオブジェクトを作成します。
+ * 要素はリストとして変更されるまで作成されません。
+ */
+Object* new_range(long start, long step, long length)
+{
+    Object* obj = new_object();
+    obj->type = RANGE;
+    obj->range = malloc(sizeof(Range));
+    if(obj->range == NULL) {
+        output_error("Runtime Error: Failed to make Object.\n");
+    }
+    obj->range->start = start;
+    obj->range->step = step;
+    obj->range->length = length;
+    return obj;
+}
+
+/**
+ * マップのオブジェクトを作成します。
+ */
+Object* new_map(Map* map)
+{
+    Object* obj = new_object();
+    obj->type = MAP;
+    obj->map = map;
+    return obj;
+}
+
+/**
+ * 集合のオブジェクトを作成します。
+ */
+Object* new_set(Set* set)
+{
+    Object* obj = new_object();
+    obj->type = SET;
+    obj->set = set;
+    return obj;
+}
+
+/**
+ * ヒープのオブジェクトを作成します。
+ */
+Object* new_heap(Heap* heap)
+{
+    Object* obj = new_object();
+    obj->type = HEAP;
+    obj->heap = heap;
+    return obj;
+}
+
+/**
+ * 両端キューのオブジェクトを作成します。
+ */
+Object* new_deque(Deque* deque)
+{
+    Object* obj = new_object();
+    obj->type = DEQUE;
+    obj->deque = deque;
+    return obj;
+}
+
+/**
+ * レコードのオブジェクトを作成します。
+ */
+Object* new_record(Record* record)
+{
+    Object* obj = new_object();
+    obj->type = RECORD;
+    obj->record = record;
+    return obj;
+}
+
+/**
+ * レコードの型のオブジェクトを作成します。
+ * 関数と同じく呼び出すと、その型のレコードを作成します。
+ */
+Object* new_record_type(Shape* shape)
+{
+    Object* obj = new_object();
+    obj->type = RECORD_TYPE;
+    obj->shape = shape;
+    return obj;
+}
+
+/**
+ * ジェネレーターのオブジェクトを作成します。
+ */
+Object* new_generator(Generator* generator)
+{
+    Object* obj = new_object();
+    obj->type = GENERATOR;
+    obj->generator = generator;
+    return obj;
+}
+
+/**
+ * 遅延評価される列のオブジェクトを作成します。
+ */
+Object* new_sequence(Sequence* sequence)
+{
+    Object* obj = new_object();
+    obj->type = SEQUENCE;
+    obj->sequence = sequence;
+    return obj;
+}
+
 /**
  * 関数のオブジェクトを作成します。
  */
@@ -81,12 +221,13 @@ Object* new_func(Ast* params, Ast* block, Environment* env)
     obj->type = FUNCTION;
     obj->func = malloc(sizeof(Function));
     if(obj->func == NULL) {
-        fprintf(stderr, "Runtime Error: Failed to make Object.\n");
-        exit(EXIT_FAILURE);
+        output_error("Runtime Error: Failed to make Object.\n");
     }
     obj->func->params = params;
     obj->func->block = block;
     obj->func->env = env;
+    obj->func->is_generator = false;
+    obj->func->memo = NULL;
     return obj;
 }
 
@@ -102,23 +243,205 @@ Object* new_result(Object* result)
 }
 
 /**
- * breakのオブジェクトを作成します。
+ * 末尾呼び出しのオブジェクトを作成します。
+ * 呼び出し元の関数から戻った後に、呼び出し元と同じ場所で実行されます。
  */
-Object* new_break(void)
+Object* new_tail_call(Object* function, Object* arguments, Ast* call)
 {
     Object* obj = new_object();
-    obj->type = BREAK;
+    obj->type = TAIL_CALL;
+    obj->tail_call = malloc(sizeof(TailCall));
+    if(obj->tail_call == NULL) {
+        output_error("Runtime Error: Failed to make Object.\n");
+    }
+    obj->tail_call->function = function;
+    obj->tail_call->arguments = arguments;
+    obj->tail_call->call = call;
     return obj;
 }
 
 /**
- * continueのオブジェクトを作成します。
+ * breakのオブジェクトを返します。
+ * 値を持たないため、繰り返しごとに作らずに1つのオブジェクトを使い回します。
+ */
+Object* new_break(void)
+{
+    static Object* shared = NULL;
+    if(shared == NULL) {
+        shared = new_object();
+        shared->type = BREAK;
+    }
+    return shared;
+}
+
+/**
+ * continueのオブジェクトを返します。
+ * 値を持たないため、繰り返しごとに作らずに1つのオブジェクトを使い回します。
  */
 Object* new_continue(void)
 {
-    Object* obj = new_object();
-    obj->type = CONTINUE;
-    return obj;
+    static Object* shared = NULL;
+    if(shared == NULL) {
+        shared = new_object();
+        shared->type = CONTINUE;
+    }
+    return shared;
+}
+
+/**
+ * 等差数列のindex番目の値を返します。
+ */
+long range_at(Range* range, long index)
+{
+    return (long)((unsigned long)range->start + (unsigned long)index * (unsigned long)range->step);
+}
+
+/**
+ * 遅延評価される列の値を全て計算してリストに変換します。
+ */
+static List* sequence_materialize(Object* self)
+{
+    List* list = newList(Object*);
+    Iterator* iterator = newIterator(self);
+    while(has_next(iterator)) {
+        Object* value = next(iterator);
+        add(list, &value);
+    }
+    dIterator(iterator);
+    free(self->sequence);
+    self->type = LIST;
+    self->list = list;
+    return list;
+}
+
+/**
+ * 等差数列、型付き配列または遅延評価される列をリストに変換し、そのリストを返します。
+ * オブジェクト自身をリストに置き換えるため、同じオブジェクトを参照している変数にも反映されます。
+ * リストの要素数はintで表すため、それを超える長さの場合はエラーとします。
+ */
+List* obj_materialize(Object* self)
+{
+    if(self->type == SEQUENCE) return sequence_materialize(self);
+    long length = (self->type == RANGE) ? self->range->length : is_typed_array(self) ? self->array->length : 0;
+    if(length > INT_MAX) {
+        output_error("Runtime Error: Cannot make a list of %ld elements.\n", length);
+    }
+    if(is_typed_array(self)) {
+        TypedArray* array = self->array;
+        List* list = newList(Object*);
+        reserve(list, (int)array->length);
+        for(long index = 0; index < array->length; index++) {
+            Object* value = typed_at(self, index);
+            add(list, &value);
+        }
+        dTypedArray(array);
+        self->type = LIST;
+        self->list = list;
+        return list;
+    }
+    if(self->type != RANGE) return self->list;
+
+    Range* range = self->range;
+    List* list = newList(Object*);
+    reserve(list, (int)range->length);
+    for(long index = 0; index < range->length; index++) {
+        Object* value = new_int(range_at(range, index));
+        add(list, &value);
+    }
+    free(range);
+    self->type = LIST;
+    self->list = list;
+    return list;
+}
+
+/**
+ * 型付き配列であるか判定します。
+ */
+bool is_typed_array(Object* self)
+{
+    return self != NULL && (self->type == INT_ARRAY || self->type == FLOAT_ARRAY);
+}
+
+/**
+ * 型付き配列のindex番目の要素をオブジェクトにして返します。範囲外の場合はNULLを返します。
+ */
+Object* typed_at(Object* self, long index)
+{
+    if(index < 0 || index >= self->array->length) return NULL;
+    if(self->type == INT_ARRAY) return new_int(self->array->integers[index]);
+    return new_float(self->array->reals[index]);
+}
+
+/**
+ * 型付き配列のindex番目に値を格納し、格納できたかどうかを返します。
+ * 値はobj_prepare_storeで格納できるようにしたものに限ります。
+ */
+bool typed_set(Object* self, long index, Object* value)
+{
+    if(index < 0 || index >= self->array->length) return false;
+    if(self->type == INT_ARRAY) self->array->integers[index] = value->integer;
+    else self->array->reals[index] = value->real;
+    return true;
+}
+
+/**
+ * 配列に値を格納したり要素を取り除いたりできるように変換します。
+ * 等差数列は値が整数であれば整数の型付き配列に、型付き配列は要素と型の違う値であればリストに変換します。
+ * valueがNULLの場合は要素を取り除くための変換とします。
+ */
+void obj_prepare_store(Object* self, Object* value)
+{
+    if(self->type == SEQUENCE) {
+        obj_materialize(self);
+    } else if(self->type == RANGE && (value == NULL || value->type == INTEGER)) {
+        Range* range = self->range;
+        TypedArray* array = newTypedArray(range->length);
+        for(long index = 0; index < range->length; index++)
+            array->integers[index] = range_at(range, index);
+        array->length = range->length;
+        free(range);
+        self->type = INT_ARRAY;
+        self->array = array;
+    } else if(self->type == RANGE) {
+        obj_materialize(self);
+    } else if(value != NULL && is_typed_array(self) &&
+                value->type != ((self->type == INT_ARRAY) ? INTEGER : FLOAT)) {
+        obj_materialize(self);
+    }
+}
+
+/**
+ * 要素が全て整数、または全て実数のリストを型付き配列に変換します。
+ * オブジェクト自身を置き換えるため、作成したばかりのリストにだけ使います。
+ */
+Object* obj_pack(Object* self)
+{
+    if(self->type != LIST) return self;
+    int size = getSize(self->list);
+    if(size == 0) return self;
+
+    Object* first;
+    getAt(self->list, 0, Object*, &first);
+    if(first == NULL || (first->type != INTEGER && first->type != FLOAT)) return self;
+    ObjectType element_type = first->type;
+    for(int index = 1; index < size; index++) {
+        Object* item;
+        getAt(self->list, index, Object*, &item);
+        if(item == NULL || item->type != element_type) return self;
+    }
+
+    TypedArray* array = newTypedArray(size);
+    for(int index = 0; index < size; index++) {
+        Object* item;
+        getAt(self->list, index, Object*, &item);
+        if(element_type == INTEGER) array->integers[index] = item->integer;
+        else array->reals[index] = item->real;
+    }
+    array->length = size;
+    dList(self->list);
+    self->type = (element_type == INTEGER) ? INT_ARRAY : FLOAT_ARRAY;
+    self->array = array;
+    return self;
 }
 
 /**
@@ -133,12 +456,28 @@ void obj_free(Object* self)
         case LIST:
             dList(self->list);
             break;
+        case INT_ARRAY:
+        case FLOAT_ARRAY:
+            dTypedArray(self->array);
+            break;
+        case RANGE:
+            free(self->range);
+            break;
+        case SEQUENCE:
+            free(self->sequence);
+            break;
+        case GENERATOR:
+            dGenerator(self->generator);
+            break;
         case FUNCTION:
             free(self->func);
             break;
         case RETURN:
             obj_free(self->result);
             break;
+        case TAIL_CALL:
+            free(self->tail_call);
+            break;
         default: break;
     }
     free(self);
@@ -156,7 +495,23 @@ Object* obj_copy(Object* self)
         case STRING:    return new_string(self->string);
         case BOOL:      return new_bool(self->boolean);
         case LIST:      return new_array(self->list);
-        case FUNCTION:  return new_func(self->func->params, self->func->block, self->func->env);
+        case MAP:       return new_map(self->map);
+        case SET:       return new_set(self->set);
+        case HEAP:      return new_heap(self->heap);
+        case DEQUE:     return new_deque(self->deque);
+        case RECORD:    return new_record(self->record);
+        case RECORD_TYPE: return self;
+        case INT_ARRAY:
+        case FLOAT_ARRAY:
+        case RANGE:     return self;
+        case SEQUENCE:  return self;
+        case GENERATOR: return new_generator(self->generator);
+        case FUNCTION: {
+            Object* copy = new_func(self->func->params, self->func->block, self->func->env);
+            copy->func->is_generator = self->func->is_generator;
+            copy->func->memo = self->func->memo;
+            return copy;
+        }
         case RETURN:     return new_result(self->result);
         default: return NULL;
     }
@@ -167,26 +522,211 @@ Object* obj_copy(Object* self)
  */
 static char* list_toString(Object* self)
 {
-    char buffer[1 << 17] = "[";
+    size_t capacity = 64;
+    size_t length = 1;
+    char* buffer = malloc(capacity);
+    if(buffer == NULL) {
+        output_error("Runtime Error: Failed to make String.\n");
+    }
+    buffer[0] = '[';
     int size = getSize(self->list);
 
     for (int i = 0; i < size; i++) {
         Object* item = NULL;
         LIST_ERROR getErr = getAt(self->list, i, Object*, &item);
         
-        if (getErr == LIST_OK && item != NULL) {
-            char* item_str = obj_toString(item);
-            strncat(buffer, item_str, sizeof(buffer) - strlen(buffer) - 1);
-            free(item_str);
+        char* item_str = (getErr == LIST_OK && item != NULL) ? obj_toString(item) : strdup("");
+        size_t item_length = strlen(item_str);
+        if(capacity - length < item_length + 3) {
+            while(capacity - length < item_length + 3) capacity *= 2;
+            char* tmp = realloc(buffer, capacity);
+            if(tmp == NULL) {
+                output_error("Runtime Error: Failed to make String.\n");
+            }
+            buffer = tmp;
         }
+        memcpy(buffer + length, item_str, item_length);
+        length += item_length;
+        free(item_str);
         if (i < size - 1) {
-            strncat(buffer, ", ", sizeof(buffer) - strlen(buffer) - 1);
+            buffer[length++] = ',';
+            buffer[length++] = ' ';
         }
     }
 
-    strncat(buffer, "]", sizeof(buffer) - strlen(buffer) - 1);
-    
-    return strdup(buffer);
+    buffer[length++] = ']';
+    buffer[length] = '\0';
+    return buffer;
+}
+
+/**
+ * 等差数列や型付き配列をリストと同じ形式の文字列に変換します。
+ * 要素のオブジェクトは作成しません。
+ */
+static char* numbers_toString(Object* self)
+{
+    long count = (self->type == RANGE) ? self->range->length : self->array->length;
+    size_t capacity = 64;
+    size_t length = 1;
+    char* buffer = malloc(capacity);
+    if(buffer == NULL) {
+        output_error("Runtime Error: Failed to make String.\n");
+    }
+    buffer[0] = '[';
+
+    for(long index = 0; index < count; index++) {
+        if(capacity - length < NUMBER_BUFFER_SIZE + 3) {
+            capacity *= 2;
+            char* tmp = realloc(buffer, capacity);
+            if(tmp == NULL) {
+                output_error("Runtime Error: Failed to make String.\n");
+            }
+            buffer = tmp;
+        }
+        if(index > 0) {
+            buffer[length++] = ',';
+            buffer[length++] = ' ';
+        }
+        if(self->type == RANGE) length += format_long(buffer + length, range_at(self->range, index));
+        else if(self->type == INT_ARRAY) length += format_long(buffer + length, self->array->integers[index]);
+        else length += format_double(buffer + length, self->array->reals[index]);
+    }
+    buffer[length++] = ']';
+    buffer[length] = '\0';
+    return buffer;
+}
+
+/**
+ * マップを{キー: 値, ...}の形式の文字列に変換します。
+ */
+static char* map_toString(Object* self)
+{
+    Map* map = self->map;
+    size_t capacity = 64;
+    size_t length = 1;
+    char* buffer = malloc(capacity);
+    if(buffer == NULL) {
+        output_error("Runtime Error: Failed to make String.\n");
+    }
+    buffer[0] = '{';
+
+    bool is_first = true;
+    for(int index = 0; index < map->used; index++) {
+        MapEntry* entry = &map->entries[index];
+        if(entry->key == NULL) continue;
+        char* key_str = obj_toString(entry->key);
+        char* value_str = obj_toString(entry->value);
+        size_t key_length = strlen(key_str);
+        size_t value_length = strlen(value_str);
+        if(capacity - length < key_length + value_length + 6) {
+            while(capacity - length < key_length + value_length + 6) capacity *= 2;
+            char* tmp = realloc(buffer, capacity);
+            if(tmp == NULL) {
+                output_error("Runtime Error: Failed to make String.\n");
+            }
+            buffer = tmp;
+        }
+        if(!is_first) {
+            buffer[length++] = ',';
+            buffer[length++] = ' ';
+        }
+        memcpy(buffer + length, key_str, key_length);
+        length += key_length;
+        buffer[length++] = ':';
+        buffer[length++] = ' ';
+        memcpy(buffer + length, value_str, value_length);
+        length += value_length;
+        free(key_str);
+        free(value_str);
+        is_first = false;
+    }
+
+    buffer[length++] = '}';
+    buffer[length] = '\0';
+    return buffer;
+}
+
+/**
+ * 集合を{要素, ...}の形式の文字列に変換します。
+ */
+static char* set_toString(Object* self)
+{
+    List* items = set_items(self->set);
+    Object* list = new_array(items);
+    char* string = list_toString(list);
+    string[0] = '{';
+    string[strlen(string) - 1] = '}';
+    dList(items);
+    free(list);
+    return string;
+}
+
+/**
+ * 両端キューを[要素, ...]の形式の文字列に変換します。
+ */
+static char* deque_toString(Object* self)
+{
+    Deque* deque = self->deque;
+    List* items = newList(Object*);
+    reserve(items, deque->count);
+    for(long index = 0; index < deque->count; index++) {
+        Object* value = deque_at(deque, index);
+        add(items, &value);
+    }
+    Object* list = new_array(items);
+    char* string = list_toString(list);
+    dList(items);
+    free(list);
+    return string;
+}
+
+/**
+ * レコードを型名(フィールド: 値, ...)の形式の文字列に変換します。
+ */
+static char* record_toString(Object* self)
+{
+    Record* record = self->record;
+    Shape* shape = record->shape;
+    size_t capacity = 64;
+    size_t length = 0;
+    char* buffer = malloc(capacity);
+    if(buffer == NULL) {
+        output_error("Runtime Error: Failed to make String.\n");
+    }
+
+    for(int index = -1; index < shape->field_count; index++) {
+        char* value_str = (index < 0) ? NULL : obj_toString(record->slots[index]);
+        const char* text = (index < 0) ? shape->name : shape->fields[index];
+        size_t text_length = strlen(text);
+        size_t value_length = (value_str == NULL) ? 0 : strlen(value_str);
+        if(capacity - length < text_length + value_length + 6) {
+            while(capacity - length < text_length + value_length + 6) capacity *= 2;
+            char* tmp = realloc(buffer, capacity);
+            if(tmp == NULL) {
+                output_error("Runtime Error: Failed to make String.\n");
+            }
+            buffer = tmp;
+        }
+        if(index > 0) {
+            buffer[length++] = ',';
+            buffer[length++] = ' ';
+        }
+        memcpy(buffer + length, text, text_length);
+        length += text_length;
+        if(value_str == NULL) {
+            buffer[length++] = '(';
+            continue;
+        }
+        buffer[length++] = ':';
+        buffer[length++] = ' ';
+        memcpy(buffer + length, value_str, value_length);
+        length += value_length;
+        free(value_str);
+    }
+
+    buffer[length++] = ')';
+    buffer[length] = '\0';
+    return buffer;
 }
 
 /**
@@ -194,16 +734,35 @@ static char* list_toString(Object* self)
  */
 char* obj_toString(Object* self)
 {
-    char buffer[1024];
+    char buffer[NUMBER_BUFFER_SIZE];
     if (self == NULL) return strdup("null");
 
     switch (self->type) {
-        case INTEGER: sprintf(buffer, "%ld", self->integer); break;
-        case FLOAT:   sprintf(buffer, "%g", self->real);     break;
+        case INTEGER: format_long(buffer, self->integer);  break;
+        case FLOAT:   format_double(buffer, self->real);   break;
         case STRING:  return strdup(self->string);
         case BOOL:    return strdup(self->boolean ? "true" : "false");
         case LIST:    return list_toString(self);
-        default:      sprintf(buffer, "<obj:%p>", (void*)self); break;
+        case MAP:     return map_toString(self);
+        case SET:     return set_toString(self);
+        case DEQUE:   return deque_toString(self);
+        case RECORD:  return record_toString(self);
+        case RECORD_TYPE: {
+            size_t size = strlen(self->shape->name) + sizeof("<record >");
+            char* string = malloc(size);
+            if(string == NULL) {
+                output_error("Runtime Error: Failed to make String.\n");
+            }
+            snprintf(string, size, "<record %s>", self->shape->name);
+            return string;
+        }
+        case INT_ARRAY:
+        case FLOAT_ARRAY:
+        case RANGE:   return numbers_toString(self);
+        case GENERATOR: return strdup("<generator>");
+        case SEQUENCE:  return strdup("<sequence>");
+        case HEAP:      return strdup("<heap>");
+        default:      snprintf(buffer, sizeof(buffer), "<obj:%p>", (void*)self); break;
     }
     return strdup(buffer);
 }
@@ -220,11 +779,13 @@ void print_object(Object* obj)
 
     switch (obj->type) {
         case INTEGER:
-            fprintf(stderr, "%ld", obj->integer);
-            break;
-        case FLOAT:
-            fprintf(stderr, "%g", obj->real);
+        case FLOAT: {
+            char buffer[NUMBER_BUFFER_SIZE];
+            if(obj->type == INTEGER) format_long(buffer, obj->integer);
+            else format_double(buffer, obj->real);
+            fprintf(stderr, "%s", buffer);
             break;
+        }
         case STRING:
             fprintf(stderr, "%s", obj->string);
             break;
@@ -242,6 +803,25 @@ void print_object(Object* obj)
             fprintf(stderr, "]");
             break;
         }
+        case INT_ARRAY:
+        case FLOAT_ARRAY:
+        case RANGE: {
+            char* string = numbers_toString(obj);
+            fprintf(stderr, "%s", string);
+            free(string);
+            break;
+        }
+        case MAP:
+        case SET:
+        case HEAP:
+        case DEQUE:
+        case RECORD:
+        case RECORD_TYPE: {
+            char* string = obj_toString(obj);
+            fprintf(stderr, "%s", string);
+            free(string);
+            break;
+        }
         default:
             fprintf(stderr, "<object at %p>", (void*)obj);
             break;
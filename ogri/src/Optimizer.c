@@ -0,0 +1,1135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "Ast.h"
+#include "Evaluate.h"
+#include "List.h"
+#include "Object.h"
+#include "Optimizer.h"
+#include "TypeInference.h"
+
+static Ast* optimize_node(Ast*);
+
+/**
+ * 実行時に値の変わらない式であるか判定します。
+ */
+static bool is_constant(Ast* node)
+{
+    if(node == NULL) return false;
+    return node->kind == AST_INTEGER || node->kind == AST_FLOAT ||
+            node->kind == AST_STRING || node->kind == AST_BOOL;
+}
+
+/**
+ * 定数の式の値を返します。
+ * 定数は環境に依存しないため、そのまま実行して値を求めます。
+ */
+static Object* constant_value(Ast* node)
+{
+    return eval(node, NULL, NULL);
+}
+
+/**
+ * 値から定数の抽象木を作成します。
+ * 定数として表せない値の場合はNULLを返します。
+ */
+static Ast* constant_node(Object* value, int line)
+{
+    Ast* node = NULL;
+    switch(value->type) {
+        case INTEGER:
+            node = new_ast(AST_INTEGER);
+            node->integer.value = value->integer;
+            break;
+        case FLOAT:
+            node = new_ast(AST_FLOAT);
+            node->real.value = value->real;
+            break;
+        case STRING:
+            node = new_ast(AST_STRING);
+            node->string.value = strdup(value->string);
+            break;
+        case BOOL:
+            return ast_bool(value->boolean, line);
+        default:
+            return NULL;
+    }
+    node->line = line;
+    return node;
+}
+
+/**
+ * 実行すると必ず数値になるか、エラーになる式であるか判定します。
+ */
+static bool is_numeric(Ast* node)
+{
+    if(node == NULL) return false;
+    switch(node->kind) {
+        case AST_INTEGER:
+        case AST_FLOAT:
+            return true;
+        case AST_UNARY:
+            return strcmp(node->unary.op, "not") != 0;
+        case AST_BINOP: {
+            const char* op = node->binop.op;
+            if(strcmp(op, "-") == 0 || strcmp(op, "*") == 0 || strcmp(op, "/") == 0 || strcmp(op, "%") == 0)
+                return true;
+            if(strcmp(op, "+") == 0)
+                return is_numeric(node->binop.left) && is_numeric(node->binop.right);
+            return false;
+        }
+        default:
+            return false;
+    }
+}
+
+/**
+ * 比較演算子であるか判定します。
+ */
+static bool is_comparison(const char* op)
+{
+    return strcmp(op, "==") == 0 || strcmp(op, "!=") == 0 || strcmp(op, "<") == 0 ||
+            strcmp(op, ">") == 0 || strcmp(op, "<=") == 0 || strcmp(op, ">=") == 0;
+}
+
+/**
+ * 定数同士の二項演算を実行時と同じ結果で畳み込めるか判定します。
+ * 実行時にエラーとなる組み合わせは畳み込まずに残します。
+ */
+static bool is_foldable(const char* op, Object* left, Object* right)
+{
+    if(left->type == STRING && right->type == STRING)
+        return strcmp(op, "+") == 0 || strcmp(op, "==") == 0 || strcmp(op, "!=") == 0;
+
+    bool left_number = (left->type == INTEGER || left->type == FLOAT);
+    bool right_number = (right->type == INTEGER || right->type == FLOAT);
+    if(!left_number || !right_number) return false;
+
+    if(strcmp(op, "+") == 0 || strcmp(op, "-") == 0 || strcmp(op, "*") == 0 || is_comparison(op))
+        return true;
+
+    if(left->type == INTEGER && right->type == INTEGER) {
+        if(strcmp(op, "/") == 0 || strcmp(op, "%") == 0)
+            return right->integer != 0 && !(left->integer == LONG_MIN && right->integer == -1);
+        return false;
+    }
+    if(strcmp(op, "/") == 0) {
+        double divisor = (right->type == FLOAT) ? right->real : (double)right->integer;
+        return divisor != 0;
+    }
+    return false;
+}
+
+/**
+ * 整数の定数であり、その値がvalueであるか判定します。
+ */
+static bool is_integer_of(Ast* node, long value)
+{
+    return node != NULL && node->kind == AST_INTEGER && node->integer.value == value;
+}
+
+/**
+ * 二項演算を最適化します。
+ */
+static Ast* optimize_binop(Ast* node)
+{
+    node->binop.left = optimize_node(node->binop.left);
+    node->binop.right = optimize_node(node->binop.right);
+    Ast* left = node->binop.left;
+    Ast* right = node->binop.right;
+    const char* op = node->binop.op;
+
+    if(strcmp(op, "and") == 0 || strcmp(op, "or") == 0) {
+        if(!is_constant(left)) return node;
+        bool truth = is_true(constant_value(left));
+        if(strcmp(op, "and") == 0) return truth ? right : left;
+        return truth ? left : right;
+    }
+
+    if(is_constant(left) && is_constant(right)) {
+        Object* left_value = constant_value(left);
+        Object* right_value = constant_value(right);
+        if(is_foldable(op, left_value, right_value)) {
+            Ast* folded = constant_node(eval_binop(node, NULL, NULL), node->line);
+            if(folded != NULL) return folded;
+        }
+        return node;
+    }
+
+    // 数値にしかならない式に対する x * 1, 1 * x, x / 1, x - 0 は x と同じ値になります。
+    if((strcmp(op, "*") == 0 || strcmp(op, "/") == 0 || strcmp(op, "-") == 0) && is_numeric(left)) {
+        long identity = (strcmp(op, "-") == 0) ? 0 : 1;
+        if(is_integer_of(right, identity)) return left;
+    }
+    if(strcmp(op, "*") == 0 && is_integer_of(left, 1) && is_numeric(right))
+        return right;
+
+    return node;
+}
+
+/**
+ * 単項演算を最適化します。
+ */
+static Ast* optimize_unary(Ast* node)
+{
+    node->unary.expr = optimize_node(node->unary.expr);
+    Ast* expr = node->unary.expr;
+    if(!is_constant(expr)) return node;
+
+    if(strcmp(node->unary.op, "not") == 0)
+        return ast_bool(!is_true(constant_value(expr)), node->line);
+    if(expr->kind != AST_INTEGER && expr->kind != AST_FLOAT)
+        return node;
+
+    Ast* folded = constant_node(eval_unary(node, NULL, NULL), node->line);
+    return (folded != NULL) ? folded : node;
+}
+
+/**
+ * 値リストの要素を左から順に集めます。
+ */
+static void collect_values(Ast* node, List* values)
+{
+    if(node == NULL) return;
+    if(node->kind == AST_VALUE_LIST) {
+        collect_values(node->value_list.first, values);
+        if(node->value_list.next != NULL) add(values, &node->value_list.next);
+    } else {
+        add(values, &node);
+    }
+}
+
+/**
+ * 値リストの各要素を最適化します。
+ * 入れ子になった値リストは1つの値リストの一部として扱います。
+ */
+static void optimize_values(Ast* node)
+{
+    if(node->value_list.first != NULL && node->value_list.first->kind == AST_VALUE_LIST)
+        optimize_values(node->value_list.first);
+    else
+        node->value_list.first = optimize_node(node->value_list.first);
+    node->value_list.next = optimize_node(node->value_list.next);
+}
+
+/**
+ * 値リストを最適化します。
+ * 要素が全て定数の場合は、実行時に複製するだけの定数のリストにします。
+ */
+static Ast* optimize_value_list(Ast* node)
+{
+    optimize_values(node);
+
+    List* values = newList(Ast*);
+    collect_values(node, values);
+    int size = getSize(values);
+    bool all_constant = true;
+    for(int index = 0; index < size && all_constant; index++) {
+        Ast* value;
+        getAt(values, index, Ast*, &value);
+        all_constant = is_constant(value);
+    }
+
+    Ast* result = node;
+    if(all_constant && size == 1) {
+        getAt(values, 0, Ast*, &result);
+    } else if(all_constant && size > 1) {
+        List* list = newList(Object*);
+        for(int index = 0; index < size; index++) {
+            Ast* value;
+            getAt(values, index, Ast*, &value);
+            Object* object = constant_value(value);
+            add(list, &object);
+        }
+        result = ast_constant(new_array(list), node->line);
+    }
+    dList(values);
+    return result;
+}
+
+/**
+ * f文字列の部分を最適化し、全てが定数であるか返します。
+ */
+static bool optimize_fstring_parts(Ast* node)
+{
+    if(node == NULL) return true;
+    if(node->kind == AST_FSTRING_PARTS) {
+        node->fstring_parts.first = optimize_node(node->fstring_parts.first);
+        node->fstring_parts.next = optimize_node(node->fstring_parts.next);
+        bool first = optimize_fstring_parts(node->fstring_parts.first);
+        bool next = optimize_fstring_parts(node->fstring_parts.next);
+        return first && next;
+    }
+    return node->kind == AST_FSTRING_TEXT || is_constant(node);
+}
+
+/**
+ * f文字列を最適化します。
+ * 埋め込まれた式が全て定数の場合は文字列にします。
+ */
+static Ast* optimize_fstring(Ast* node)
+{
+    if(!optimize_fstring_parts(node->fstring.parts)) return node;
+
+    Object* value = eval_fstring(node, NULL, NULL);
+    Ast* folded = constant_node(value, node->line);
+    obj_free(value);
+    return folded;
+}
+
+#define SWITCH_MIN_CASES 4    // 分岐表に置き換えるwhen文の分岐の数の下限
+
+/**
+ * 変数と整数または文字列の定数を比べる条件であれば、その定数を返します。
+ * subjectに変数が設定されている場合は、同じ変数を比べる条件だけを対象とします。
+ */
+static Ast* case_key(Ast* condition, Ast** subject)
+{
+    if(condition->kind != AST_BINOP || condition->binop.opcode != OP_EQ) return NULL;
+    Ast* variable = condition->binop.left;
+    Ast* key = condition->binop.right;
+    if(variable->kind != AST_IDENTIFIER) {
+        variable = condition->binop.right;
+        key = condition->binop.left;
+    }
+    if(variable->kind != AST_IDENTIFIER) return NULL;
+    if(key->kind != AST_INTEGER && key->kind != AST_STRING) return NULL;
+    if(*subject != NULL && strcmp((*subject)->identifier.name, variable->identifier.name) != 0) return NULL;
+    if(*subject == NULL) *subject = variable;
+    return key;
+}
+
+/**
+ * 同じ変数を異なる定数と比べる分岐が続くwhen文を、分岐表で実行する抽象木に置き換えます。
+ * 変数の値は1回だけ求め、整数の値が狭い範囲に並ぶ場合は値から直接、それ以外はハッシュ値から分岐を探します。
+ * 条件の形が揃わない場合は元のwhen文を返します。
+ */
+static Ast* dispatch_when(Ast* chain, List* conditions, List* blocks, Ast* other)
+{
+    int count = getSize(conditions);
+    Ast* subject = NULL;
+    Object** keys = malloc(sizeof(Object*) * count);
+    bool is_string = false;
+    long low = LONG_MAX, high = LONG_MIN;
+    for(int index = 0; index < count; index++) {
+        Ast* condition;
+        getAt(conditions, index, Ast*, &condition);
+        Ast* key = case_key(condition, &subject);
+        // 整数と文字列の比較は実行時にエラーとなるため、値の型が揃う場合だけを対象とします。
+        if(key == NULL || (index > 0 && (key->kind == AST_STRING) != is_string)) {
+            free(keys);
+            return chain;
+        }
+        is_string = (key->kind == AST_STRING);
+        keys[index] = constant_value(key);
+        if(!is_string) {
+            if(keys[index]->integer < low) low = keys[index]->integer;
+            if(keys[index]->integer > high) high = keys[index]->integer;
+        }
+    }
+
+    Ast* node = ast_switch(ast_identifier(subject->identifier.name, subject->line), chain, other, chain->line);
+    node->switch_stmt.is_string = is_string;
+    unsigned long span = (unsigned long)high - (unsigned long)low;
+    if(!is_string && span < (unsigned long)count * 2) {
+        node->switch_stmt.is_dense = true;
+        node->switch_stmt.low = low;
+        node->switch_stmt.size = (int)span + 1;
+    } else {
+        int size = 1;
+        while(size < count * 2) size *= 2;
+        node->switch_stmt.size = size;
+    }
+    node->switch_stmt.cases = calloc(node->switch_stmt.size, sizeof(SwitchCase));
+
+    for(int index = 0; index < count; index++) {
+        Ast* block;
+        getAt(blocks, index, Ast*, &block);
+        long integer = is_string ? 0 : keys[index]->integer;
+        const char* string = is_string ? keys[index]->string : NULL;
+        SwitchCase* entry = switch_case_of(node, integer, string);
+        // 同じ値の分岐は、最初のものだけが実行されます。
+        if(entry->block != NULL) continue;
+        entry->integer = integer;
+        entry->string = is_string ? strdup(string) : NULL;
+        entry->block = block;
+    }
+    free(keys);
+    return node;
+}
+
+/**
+ * when文を最適化します。
+ * 条件が定数の分岐を取り除き、必ず実行される分岐があればそれ以降を削除します。
+ * 全ての分岐が取り除かれた場合はotherwiseのブロック(なければNULL)を返します。
+ */
+static Ast* optimize_when(Ast* node)
+{
+    List* conditions = newList(Ast*);
+    List* blocks = newList(Ast*);
+    Ast* other = node->when_stmt.other_block;
+
+    add(conditions, &node->when_stmt.cond);
+    add(blocks, &node->when_stmt.then_block);
+    for(Ast* clause = node->when_stmt.otherwhen_list; clause != NULL; clause = clause->otherwhen.next) {
+        if(clause->kind == AST_BLOCK) {
+            other = clause;
+            break;
+        }
+        add(conditions, &clause->otherwhen.cond);
+        add(blocks, &clause->otherwhen.block);
+    }
+    other = optimize_node(other);
+
+    List* kept_conditions = newList(Ast*);
+    List* kept_blocks = newList(Ast*);
+    for(int index = 0; index < getSize(conditions); index++) {
+        Ast *condition, *block;
+        getAt(conditions, index, Ast*, &condition);
+        getAt(blocks, index, Ast*, &block);
+        condition = optimize_node(condition);
+        block = optimize_node(block);
+
+        if(is_constant(condition)) {
+            if(!is_true(constant_value(condition))) continue;
+            other = block;
+            break;
+        }
+        add(kept_conditions, &condition);
+        add(kept_blocks, &block);
+    }
+
+    int size = getSize(kept_conditions);
+    Ast* result = other;
+    Ast* chain = other;
+    for(int index = size - 1; index >= 0; index--) {
+        Ast *condition, *block;
+        getAt(kept_conditions, index, Ast*, &condition);
+        getAt(kept_blocks, index, Ast*, &block);
+        if(index > 0) {
+            chain = ast_otherwhen(condition, block, chain, condition->line);
+        } else if(size > 1) {
+            result = ast_when(condition, block, chain, NULL, node->line);
+        } else {
+            result = ast_when(condition, block, NULL, other, node->line);
+        }
+    }
+    if(size >= SWITCH_MIN_CASES) result = dispatch_when(result, kept_conditions, kept_blocks, other);
+
+    dList(conditions);
+    dList(blocks);
+    dList(kept_conditions);
+    dList(kept_blocks);
+    return result;
+}
+
+/**
+ * 抽象木を再帰的に探索して最適化し、置き換える抽象木を返します。
+ */
+static Ast* optimize_node(Ast* node)
+{
+    if(node == NULL) return NULL;
+    switch(node->kind) {
+        case AST_STATEMENTS:
+            node->list.first = optimize_node(node->list.first);
+            node->list.next = optimize_node(node->list.next);
+            return node;
+        case AST_BLOCK:
+            node->block.statements = optimize_node(node->block.statements);
+            return node;
+        case AST_WHEN:
+            return optimize_when(node);
+        case AST_REPEAT:
+            node->repeat_stmt.collection = optimize_node(node->repeat_stmt.collection);
+            node->repeat_stmt.block = optimize_node(node->repeat_stmt.block);
+            return node;
+        case AST_REPEAT_UNTIL:
+            node->repeat_until_stmt.cond = optimize_node(node->repeat_until_stmt.cond);
+            node->repeat_until_stmt.block = optimize_node(node->repeat_until_stmt.block);
+            return node;
+        case AST_FUNC_DEF:
+            node->func_def.body = optimize_node(node->func_def.body);
+            return node;
+        case AST_ASSIGN:
+            node->assign.left = optimize_node(node->assign.left);
+            node->assign.right = optimize_node(node->assign.right);
+            return node;
+        case AST_RETURN:
+            node->return_stmt.expr = optimize_node(node->return_stmt.expr);
+            return node;
+        case AST_YIELD:
+            node->yield_stmt.expr = optimize_node(node->yield_stmt.expr);
+            return node;
+        case AST_FUNC_CALL:
+            node->func_call.args = optimize_node(node->func_call.args);
+            return node;
+        case AST_BINOP:
+            return optimize_binop(node);
+        case AST_UNARY:
+            return optimize_unary(node);
+        case AST_FSTRING:
+            return optimize_fstring(node);
+        case AST_VALUE_LIST:
+            return optimize_value_list(node);
+        case AST_ARRAY_ACCESS:
+            node->array_access.index = optimize_node(node->array_access.index);
+            return node;
+        case AST_SLICE:
+            node->slice.index = optimize_node(node->slice.index);
+            return node;
+        case AST_RANGE:
+            node->range.from = optimize_node(node->range.from);
+            node->range.end = optimize_node(node->range.end);
+            return node;
+        case AST_MAP:
+            node->map_literal.previous = optimize_node(node->map_literal.previous);
+            node->map_literal.key = optimize_node(node->map_literal.key);
+            node->map_literal.value = optimize_node(node->map_literal.value);
+            return node;
+        case AST_FIELD:
+            node->field.object = optimize_node(node->field.object);
+            return node;
+        default:
+            return node;
+    }
+}
+
+#define MAX_CHILDREN 4
+
+/**
+ * 子の抽象木を置いている場所を実行される順に集め、その数を返します。
+ * 変数名や関数名のように式として実行されない子は含めません。
+ */
+static int child_slots(Ast* node, Ast** slots[MAX_CHILDREN])
+{
+    switch(node->kind) {
+        case AST_STATEMENTS:
+            slots[0] = &node->list.first;
+            slots[1] = &node->list.next;
+            return 2;
+        case AST_WHEN:
+            slots[0] = &node->when_stmt.cond;
+            slots[1] = &node->when_stmt.then_block;
+            slots[2] = &node->when_stmt.otherwhen_list;
+            slots[3] = &node->when_stmt.other_block;
+            return 4;
+        case AST_OTHERWHEN:
+            slots[0] = &node->otherwhen.cond;
+            slots[1] = &node->otherwhen.block;
+            slots[2] = &node->otherwhen.next;
+            return 3;
+        case AST_REPEAT:
+            slots[0] = &node->repeat_stmt.collection;
+            slots[1] = &node->repeat_stmt.block;
+            return 2;
+        case AST_REPEAT_UNTIL:
+            slots[0] = &node->repeat_until_stmt.cond;
+            slots[1] = &node->repeat_until_stmt.block;
+            return 2;
+        case AST_FUNC_DEF:
+            slots[0] = &node->func_def.body;
+            return 1;
+        case AST_ASSIGN:
+            slots[0] = &node->assign.right;
+            if(node->assign.left->kind == AST_FIELD) {
+                slots[1] = &node->assign.left->field.object;
+                return 2;
+            }
+            if(node->assign.left->kind != AST_ARRAY_ACCESS) return 1;
+            slots[1] = &node->assign.left->array_access.index;
+            return 2;
+        case AST_RETURN:
+            // 末尾呼び出しは関数呼び出しのまま残す必要があるため、その引数だけを子とします。
+            if(node->return_stmt.is_tail_call) {
+                slots[0] = &node->return_stmt.expr->func_call.args;
+                return 1;
+            }
+            slots[0] = &node->return_stmt.expr;
+            return 1;
+        case AST_YIELD:
+            slots[0] = &node->yield_stmt.expr;
+            return 1;
+        case AST_FUNC_CALL:
+            slots[0] = &node->func_call.args;
+            return 1;
+        case AST_BLOCK:
+            slots[0] = &node->block.statements;
+            return 1;
+        case AST_BINOP:
+            slots[0] = &node->binop.left;
+            slots[1] = &node->binop.right;
+            return 2;
+        case AST_UNARY:
+            slots[0] = &node->unary.expr;
+            return 1;
+        case AST_FSTRING:
+            slots[0] = &node->fstring.parts;
+            return 1;
+        case AST_FSTRING_PARTS:
+            slots[0] = &node->fstring_parts.first;
+            slots[1] = &node->fstring_parts.next;
+            return 2;
+        case AST_VALUE_LIST:
+            slots[0] = &node->value_list.first;
+            slots[1] = &node->value_list.next;
+            return 2;
+        case AST_ARRAY_ACCESS:
+            slots[0] = &node->array_access.index;
+            return 1;
+        case AST_SLICE:
+            slots[0] = &node->slice.index;
+            return 1;
+        case AST_RANGE:
+            slots[0] = &node->range.from;
+            slots[1] = &node->range.end;
+            return 2;
+        case AST_MAP:
+            slots[0] = &node->map_literal.previous;
+            slots[1] = &node->map_literal.key;
+            slots[2] = &node->map_literal.value;
+            return 3;
+        case AST_FIELD:
+            slots[0] = &node->field.object;
+            return 1;
+        case AST_INLINE:
+            slots[0] = &node->inline_call.call->func_call.args;
+            return 1;
+        case AST_SWITCH:
+            // 分岐表のブロックは元のwhen文と共有しているため、元のwhen文だけを子とします。
+            slots[0] = &node->switch_stmt.chain;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * 名前のリストに含まれているか判定します。
+ */
+static bool contains_name(List* names, const char* name)
+{
+    for(int index = 0; index < getSize(names); index++) {
+        const char* current;
+        getAt(names, index, const char*, &current);
+        if(strcmp(current, name) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * 代入先の変数名を集めます。
+ */
+static void collect_targets(Ast* node, List* names)
+{
+    if(node == NULL) return;
+    if(node->kind == AST_IDENTIFIER) {
+        add(names, &node->identifier.name);
+    } else if(node->kind == AST_IDENTIFIER_LIST) {
+        collect_targets(node->identifier_list.first, names);
+        collect_targets(node->identifier_list.next, names);
+    }
+}
+
+/**
+ * 代入やrepeat文、関数定義で値が束縛される変数名を集めます。
+ * into_functionsが偽の場合は、関数の本体と仮引数は探索しません。
+ */
+static void collect_bound_names(Ast* node, List* names, bool into_functions)
+{
+    if(node == NULL) return;
+    switch(node->kind) {
+        case AST_ASSIGN:
+            collect_targets(node->assign.left, names);
+            break;
+        case AST_REPEAT:
+            collect_targets(node->repeat_stmt.identifier, names);
+            break;
+        case AST_RECORD_DEF:
+            collect_targets(node->record_def.name, names);
+            break;
+        case AST_FUNC_DEF:
+            collect_targets(node->func_def.name, names);
+            if(!into_functions) return;
+            collect_targets(node->func_def.params, names);
+            break;
+        default:
+            break;
+    }
+    Ast** slots[MAX_CHILDREN];
+    int count = child_slots(node, slots);
+    for(int index = 0; index < count; index++)
+        collect_bound_names(*slots[index], names, into_functions);
+}
+
+/**
+ * 関数の本体を除いてyield文を含むか判定します。
+ */
+static bool has_yield(Ast* node)
+{
+    if(node == NULL) return false;
+    if(node->kind == AST_YIELD) return true;
+    if(node->kind == AST_FUNC_DEF) return false;
+    Ast** slots[MAX_CHILDREN];
+    int count = child_slots(node, slots);
+    for(int index = 0; index < count; index++)
+        if(has_yield(*slots[index])) return true;
+    return false;
+}
+
+static List* program_names = NULL;  // プログラム中で束縛される全ての変数名
+
+/**
+ * ビルトイン関数の名前がプログラム中で別の値に束縛されていないか判定します。
+ */
+static bool is_builtin_name(Ast* name, const char* builtin)
+{
+    return strcmp(name->identifier.name, builtin) == 0 && !contains_name(program_names, builtin);
+}
+
+/**
+ * 1つの値からなる値リストであればその値を返します。
+ */
+static Ast* single_value(Ast* node)
+{
+    if(node != NULL && node->kind == AST_VALUE_LIST && node->value_list.next == NULL)
+        return node->value_list.first;
+    return node;
+}
+
+/**
+ * ループ内で代入されない変数であるか判定します。
+ */
+static bool is_invariant_name(Ast* node, List* assigned)
+{
+    return node != NULL && node->kind == AST_IDENTIFIER && !contains_name(assigned, node->identifier.name);
+}
+
+/**
+ * ループ内で値の変わらない len with xs と i at xs であるか判定します。
+ * リストの変更や関数の実行は、実行時に値を再利用しないことで対応します。
+ */
+static bool is_loop_invariant(Ast* node, List* assigned)
+{
+    if(node->kind == AST_FUNC_CALL && is_builtin_name(node->func_call.name, "len"))
+        return is_invariant_name(single_value(node->func_call.args), assigned);
+    if(node->kind == AST_ARRAY_ACCESS) {
+        Ast* index = node->array_access.index;
+        bool is_invariant_index = (index->kind == AST_INTEGER || is_invariant_name(index, assigned));
+        return is_invariant_index && is_invariant_name(node->array_access.identifier, assigned);
+    }
+    return false;
+}
+
+/**
+ * ループ内の値の変わらない式を、ループ内で最初に求めた値を再利用する式に置き換えます。
+ */
+static void hoist_slot(Ast** slot, Ast* loop, List* assigned)
+{
+    Ast* node = *slot;
+    if(node == NULL || node->kind == AST_FUNC_DEF) return;
+    if(is_loop_invariant(node, assigned)) {
+        *slot = ast_cached(node, NULL, loop);
+        return;
+    }
+    Ast** slots[MAX_CHILDREN];
+    int count = child_slots(node, slots);
+    for(int index = 0; index < count; index++)
+        hoist_slot(slots[index], loop, assigned);
+}
+
+/**
+ * ループ不変式を探して置き換えます。
+ * 外側のループから順に探すため、入れ子のループでも最も外側のループに対して再利用します。
+ */
+static void hoist_invariants(Ast* node)
+{
+    if(node == NULL) return;
+    if((node->kind == AST_REPEAT || node->kind == AST_REPEAT_UNTIL) && !has_yield(node)) {
+        List* assigned = newList(const char*);
+        collect_bound_names(node, assigned, false);
+        if(node->kind == AST_REPEAT) {
+            hoist_slot(&node->repeat_stmt.block, node, assigned);
+        } else {
+            hoist_slot(&node->repeat_until_stmt.cond, node, assigned);
+            hoist_slot(&node->repeat_until_stmt.block, node, assigned);
+        }
+        dList(assigned);
+    }
+    Ast** slots[MAX_CHILDREN];
+    int count = child_slots(node, slots);
+    for(int index = 0; index < count; index++)
+        hoist_invariants(*slots[index]);
+}
+
+/**
+ * 実行しても変数やリストを変更せず、同じ値になる式であるか判定します。
+ */
+static bool is_pure(Ast* node)
+{
+    if(node == NULL) return true;
+    switch(node->kind) {
+        case AST_IDENTIFIER:
+        case AST_INTEGER:
+        case AST_FLOAT:
+        case AST_STRING:
+        case AST_BOOL:
+            return true;
+        case AST_BINOP:
+            return is_pure(node->binop.left) && is_pure(node->binop.right);
+        case AST_UNARY:
+            return is_pure(node->unary.expr);
+        case AST_ARRAY_ACCESS:
+            return is_pure(node->array_access.index);
+        case AST_VALUE_LIST:
+            return is_pure(node->value_list.first) && is_pure(node->value_list.next);
+        case AST_FUNC_CALL:
+            return is_builtin_name(node->func_call.name, "len") && is_pure(node->func_call.args);
+        default:
+            return false;
+    }
+}
+
+/**
+ * 同じ値になる式であるか、抽象木の構造を比較して判定します。
+ */
+static bool ast_equal(Ast* a, Ast* b)
+{
+    if(a == NULL || b == NULL) return a == b;
+    if(a->kind != b->kind) return false;
+    switch(a->kind) {
+        case AST_IDENTIFIER:
+            return strcmp(a->identifier.name, b->identifier.name) == 0;
+        case AST_INTEGER:
+            return a->integer.value == b->integer.value;
+        case AST_FLOAT:
+            return a->real.value == b->real.value;
+        case AST_STRING:
+            return strcmp(a->string.value, b->string.value) == 0;
+        case AST_BOOL:
+            return a->boolean.value == b->boolean.value;
+        case AST_BINOP:
+            return strcmp(a->binop.op, b->binop.op) == 0 &&
+                    ast_equal(a->binop.left, b->binop.left) && ast_equal(a->binop.right, b->binop.right);
+        case AST_UNARY:
+            return strcmp(a->unary.op, b->unary.op) == 0 && ast_equal(a->unary.expr, b->unary.expr);
+        case AST_ARRAY_ACCESS:
+            return ast_equal(a->array_access.index, b->array_access.index) &&
+                    ast_equal(a->array_access.identifier, b->array_access.identifier);
+        case AST_VALUE_LIST:
+            return ast_equal(a->value_list.first, b->value_list.first) &&
+                    ast_equal(a->value_list.next, b->value_list.next);
+        case AST_FUNC_CALL:
+            return ast_equal(a->func_call.name, b->func_call.name) &&
+                    ast_equal(a->func_call.args, b->func_call.args);
+        default:
+            return false;
+    }
+}
+
+/**
+ * 式の中でand, orを使っているか判定します。
+ */
+static bool has_logical(Ast* node)
+{
+    if(node == NULL) return false;
+    if(node->kind == AST_BINOP && (strcmp(node->binop.op, "and") == 0 || strcmp(node->binop.op, "or") == 0))
+        return true;
+    Ast** slots[MAX_CHILDREN];
+    int count = child_slots(node, slots);
+    for(int index = 0; index < count; index++)
+        if(has_logical(*slots[index])) return true;
+    return false;
+}
+
+/**
+ * 共通部分式の候補を置いている場所を実行される順に集めます。
+ */
+static void collect_subexpressions(Ast** slot, List* slots)
+{
+    Ast* node = *slot;
+    if(node == NULL) return;
+    bool is_candidate = (node->kind == AST_BINOP || node->kind == AST_UNARY ||
+                        node->kind == AST_ARRAY_ACCESS || node->kind == AST_FUNC_CALL);
+    if(is_candidate && is_pure(node)) add(slots, &slot);
+
+    Ast** children[MAX_CHILDREN];
+    int count = child_slots(node, children);
+    for(int index = 0; index < count; index++)
+        collect_subexpressions(children[index], slots);
+}
+
+/**
+ * 式の中で同じ値になる部分式を1つ見つけ、最初に求めた値を後の部分式で再利用するようにします。
+ * 置き換えた場合は真を返します。
+ */
+static bool share_subexpression(Ast** root)
+{
+    List* slots = newList(Ast**);
+    collect_subexpressions(root, slots);
+    int size = getSize(slots);
+    bool shared = false;
+    for(int first = 0; first < size && !shared; first++) {
+        Ast** source;
+        getAt(slots, first, Ast**, &source);
+        Ast* definition = NULL;
+        // 同じ構造の部分式が入れ子になることはないため、後に見つかるものは全て後で実行されます。
+        for(int index = first + 1; index < size; index++) {
+            Ast** slot;
+            getAt(slots, index, Ast**, &slot);
+            if(!ast_equal(*source, *slot)) continue;
+            if(definition == NULL) definition = ast_cached(*source, NULL, NULL);
+            *slot = ast_cached(*slot, definition, NULL);
+        }
+        if(definition != NULL) {
+            *source = definition;
+            shared = true;
+        }
+    }
+    dList(slots);
+    return shared;
+}
+
+/**
+ * 文の中の各式で共通部分式を取り除きます。
+ * and, orを含む式は部分式が実行されない場合があるため対象にしません。
+ */
+static void eliminate_common_subexpressions(Ast** slot)
+{
+    Ast* node = *slot;
+    if(node == NULL) return;
+    switch(node->kind) {
+        case AST_BINOP:
+        case AST_UNARY:
+        case AST_FUNC_CALL:
+        case AST_VALUE_LIST:
+        case AST_ARRAY_ACCESS:
+            if(!has_logical(node))
+                while(share_subexpression(slot));
+            return;
+        default:
+            break;
+    }
+    Ast** slots[MAX_CHILDREN];
+    int count = child_slots(node, slots);
+    for(int index = 0; index < count; index++)
+        eliminate_common_subexpressions(slots[index]);
+}
+
+#define MAX_INLINE_NODES 32     // 本体を展開する関数の戻り値の式の大きさの上限
+
+/**
+ * 名前のリストに含まれている数を返します。
+ */
+static int count_name(List* names, const char* name)
+{
+    int count = 0;
+    for(int index = 0; index < getSize(names); index++) {
+        const char* current;
+        getAt(names, index, const char*, &current);
+        if(strcmp(current, name) == 0) count++;
+    }
+    return count;
+}
+
+/**
+ * 関数の本体が1つのreturn文だけであれば、その戻り値の式を返します。
+ */
+static Ast* returned_expression(Ast* body)
+{
+    if(body != NULL && body->kind == AST_BLOCK) body = body->block.statements;
+    while(body != NULL && body->kind == AST_STATEMENTS) {
+        if(body->list.first != NULL && body->list.next != NULL) return NULL;
+        body = (body->list.first != NULL) ? body->list.first : body->list.next;
+    }
+    if(body == NULL || body->kind != AST_RETURN || body->return_stmt.is_tail_call) return NULL;
+    return body->return_stmt.expr;
+}
+
+/**
+ * 仮引数の名前を順に集め、その数を返します。
+ * 仮引数を実行時と同じ順に対応付けられない場合や、数が上限を超える場合は-1を返します。
+ */
+static int collect_params(Ast* params, const char* names[MAX_INLINE_ARGUMENTS])
+{
+    int count = 0;
+    while(params != NULL) {
+        Ast* current = (params->kind == AST_IDENTIFIER_LIST) ? params->identifier_list.first : params;
+        if(current->kind != AST_IDENTIFIER || count == MAX_INLINE_ARGUMENTS) return -1;
+        for(int index = 0; index < count; index++)
+            if(strcmp(names[index], current->identifier.name) == 0) return -1;
+        names[count++] = current->identifier.name;
+        params = (params->kind == AST_IDENTIFIER_LIST) ? params->identifier_list.next : NULL;
+    }
+    return count;
+}
+
+/**
+ * 仮引数を引数の番号に置き換えた式の複製を作成します。
+ * 仮引数以外の変数や関数呼び出しを含む式は、呼び出し元で同じ結果にならないためNULLを返します。
+ */
+static Ast* substitute_params(Ast* node, const char* names[], int count, int* size)
+{
+    if(node == NULL) return NULL;
+    if(++(*size) > MAX_INLINE_NODES) return NULL;
+
+    Ast* copy = new_ast(node->kind);
+    *copy = *node;
+    copy->closure = NULL;
+    switch(node->kind) {
+        case AST_INTEGER:
+        case AST_FLOAT:
+        case AST_STRING:
+        case AST_BOOL:
+        case AST_CONSTANT:
+        case AST_FSTRING_TEXT:
+            return copy;
+        case AST_IDENTIFIER:
+            for(int index = 0; index < count; index++)
+                if(strcmp(names[index], node->identifier.name) == 0) return ast_argument(index, node->line);
+            return NULL;
+        case AST_BINOP:
+            copy->binop.left = substitute_params(node->binop.left, names, count, size);
+            copy->binop.right = substitute_params(node->binop.right, names, count, size);
+            return (copy->binop.left != NULL && copy->binop.right != NULL) ? copy : NULL;
+        case AST_UNARY:
+            copy->unary.expr = substitute_params(node->unary.expr, names, count, size);
+            return (copy->unary.expr != NULL) ? copy : NULL;
+        case AST_VALUE_LIST:
+            copy->value_list.first = substitute_params(node->value_list.first, names, count, size);
+            if(copy->value_list.first == NULL) return NULL;
+            if(node->value_list.next == NULL) return copy;
+            copy->value_list.next = substitute_params(node->value_list.next, names, count, size);
+            return (copy->value_list.next != NULL) ? copy : NULL;
+        case AST_FSTRING:
+            copy->fstring.parts = substitute_params(node->fstring.parts, names, count, size);
+            return (copy->fstring.parts != NULL) ? copy : NULL;
+        case AST_FSTRING_PARTS:
+            copy->fstring_parts.first = substitute_params(node->fstring_parts.first, names, count, size);
+            if(copy->fstring_parts.first == NULL) return NULL;
+            if(node->fstring_parts.next == NULL) return copy;
+            copy->fstring_parts.next = substitute_params(node->fstring_parts.next, names, count, size);
+            return (copy->fstring_parts.next != NULL) ? copy : NULL;
+        default:
+            return NULL;
+    }
+}
+
+/**
+ * 本体を展開できる関数定義を集めます。
+ * 名前が他で束縛されず、本体が仮引数だけを使う1つのreturn文である関数が対象です。
+ */
+static void collect_inline_functions(Ast* node, List* functions)
+{
+    if(node == NULL) return;
+    // 結果を記録する関数は、呼び出しごとに記録を使うため展開しません。
+    if(node->kind == AST_FUNC_DEF && !node->func_def.is_generator && !node->func_def.remember &&
+        count_name(program_names, node->func_def.name->identifier.name) == 1) {
+        const char* names[MAX_INLINE_ARGUMENTS];
+        int count = collect_params(node->func_def.params, names);
+        Ast* expr = returned_expression(node->func_def.body);
+        int size = 0;
+        if(count >= 0 && expr != NULL && substitute_params(expr, names, count, &size) != NULL)
+            add(functions, &node);
+    }
+    Ast** slots[MAX_CHILDREN];
+    int count = child_slots(node, slots);
+    for(int index = 0; index < count; index++)
+        collect_inline_functions(*slots[index], functions);
+}
+
+/**
+ * 関数呼び出しを、呼び出す関数の本体を展開した式に置き換えます。
+ */
+static void inline_calls(Ast** slot, List* functions)
+{
+    Ast* node = *slot;
+    if(node == NULL) return;
+    Ast** slots[MAX_CHILDREN];
+    int count = child_slots(node, slots);
+    for(int index = 0; index < count; index++)
+        inline_calls(slots[index], functions);
+    if(node->kind != AST_FUNC_CALL) return;
+
+    for(int index = 0; index < getSize(functions); index++) {
+        Ast* function;
+        getAt(functions, index, Ast*, &function);
+        if(strcmp(function->func_def.name->identifier.name, node->func_call.name->identifier.name) != 0)
+            continue;
+        const char* names[MAX_INLINE_ARGUMENTS];
+        int argc = collect_params(function->func_def.params, names);
+        int size = 0;
+        Ast* expr = substitute_params(returned_expression(function->func_def.body), names, argc, &size);
+        *slot = ast_inline(node, function->func_def.body, expr, argc);
+        return;
+    }
+}
+
+/**
+ * 小さな関数の呼び出しを、関数の本体を展開した式に置き換えます。
+ * 展開する関数はprogramから探します。
+ * 実行時には呼び出す関数が展開したものと同じであるかを確かめます。
+ */
+static void inline_functions(Ast** root, Ast* program)
+{
+    List* functions = newList(Ast*);
+    collect_inline_functions(program, functions);
+    if(getSize(functions) > 0) inline_calls(root, functions);
+    dList(functions);
+}
+
+/**
+ * 抽象木を最適化します。
+ * 実行結果が変わらない範囲で書き換えた抽象木を返します。
+ */
+Ast* optimize(Ast* root)
+{
+    if(root == NULL) return NULL;
+    Ast* result = optimize_node(root);
+    if(result == NULL) return ast_stmts(NULL, NULL, root->line);
+
+    program_names = newList(const char*);
+    collect_bound_names(result, program_names, true);
+    inline_functions(&result, result);
+    hoist_invariants(result);
+    eliminate_common_subexpressions(&result);
+    dList(program_names);
+    program_names = NULL;
+    infer_types(result);
+    return result;
+}
+
+/**
+ * 抽象木に含まれるループを、実行中に最適化したものとして記録します。
+ */
+static void mark_optimized(Ast* node)
+{
+    if(node == NULL) return;
+    if(node->kind == AST_REPEAT) node->repeat_stmt.optimized = true;
+    if(node->kind == AST_REPEAT_UNTIL) node->repeat_until_stmt.optimized = true;
+    Ast** slots[MAX_CHILDREN];
+    int count = child_slots(node, slots);
+    for(int index = 0; index < count; index++)
+        mark_optimized(*slots[index]);
+}
+
+/**
+ * 実行中のループを最適化します。
+ * ループの抽象木をその場で書き換えるため、次の繰り返しから最適化した抽象木が実行されます。
+ * 変数の値は環境に置かれたままなので、そのまま引き継がれます。
+ * 束縛される変数名と展開する関数はプログラム全体から探します。
+ */
+void optimize_loop(Ast* loop, Ast* program)
+{
+    Ast* result = optimize_node(loop);
+
+    program_names = newList(const char*);
+    collect_bound_names(program, program_names, true);
+    inline_functions(&result, program);
+    hoist_invariants(result);
+    eliminate_common_subexpressions(&result);
+    dList(program_names);
+    program_names = NULL;
+    infer_types(result);
+    mark_optimized(result);
+}
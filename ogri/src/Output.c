@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "Output.h"
+
+#define OUTPUT_BUFFER_SIZE (1 << 17)
+
+static char buffer[OUTPUT_BUFFER_SIZE];
+static size_t used = 0;
+static bool flush_on_newline = false;
+static bool flush_always = false;
+
+/**
+ * フラッシュ方針を設定します。
+ * 終了時にバッファが書き出されるように登録します。
+ */
+void output_init(FlushPolicy policy)
+{
+    if(policy == FLUSH_AUTO)
+        policy = isatty(STDOUT_FILENO) ? FLUSH_LINE : FLUSH_FULL;
+
+    flush_on_newline = (policy == FLUSH_LINE);
+    flush_always = (policy == FLUSH_NONE);
+    atexit(output_flush);
+}
+
+/**
+ * コマンドライン引数の文字列をフラッシュ方針に変換します。
+ */
+bool output_parse_policy(const char* name, FlushPolicy* policy)
+{
+    if(strcmp(name, "auto") == 0) *policy = FLUSH_AUTO;
+    else if(strcmp(name, "line") == 0) *policy = FLUSH_LINE;
+    else if(strcmp(name, "full") == 0) *policy = FLUSH_FULL;
+    else if(strcmp(name, "none") == 0) *policy = FLUSH_NONE;
+    else return false;
+    return true;
+}
+
+/**
+ * バッファの内容を標準出力に書き出します。
+ */
+void output_flush(void)
+{
+    size_t written = 0;
+    while(written < used) {
+        ssize_t result = write(STDOUT_FILENO, buffer + written, used - written);
+        if(result <= 0) break;
+        written += (size_t)result;
+    }
+    used = 0;
+}
+
+/**
+ * バッファに書き込みます。
+ * バッファが一杯になった場合、または方針に応じて書き出します。
+ */
+void output_write(const char* data, size_t length)
+{
+    bool has_newline = flush_on_newline && memchr(data, '\n', length) != NULL;
+
+    while(length > 0) {
+        if(used == OUTPUT_BUFFER_SIZE) output_flush();
+        size_t chunk = OUTPUT_BUFFER_SIZE - used;
+        if(chunk > length) chunk = length;
+        memcpy(buffer + used, data, chunk);
+        used += chunk;
+        data += chunk;
+        length -= chunk;
+    }
+    if(flush_always || has_newline) output_flush();
+}
+
+/**
+ * 文字列をバッファに書き込みます。
+ */
+void output_string(const char* string)
+{
+    output_write(string, strlen(string));
+}
+
+/**
+ * 1文字をバッファに書き込みます。
+ */
+void output_char(char c)
+{
+    if(used == OUTPUT_BUFFER_SIZE) output_flush();
+    buffer[used++] = c;
+    if(flush_always || (flush_on_newline && c == '\n')) output_flush();
+}
+
+/**
+ * バッファに直接書き込むための領域を確保し、その先頭を返します。
+ * 書き込んだ後にoutput_commitで書き込んだ大きさを確定します。
+ */
+char* output_reserve(size_t length)
+{
+    if(OUTPUT_BUFFER_SIZE - used < length) output_flush();
+    return buffer + used;
+}
+
+/**
+ * output_reserveで確保した領域に書き込んだ大きさを確定します。
+ */
+void output_commit(size_t length)
+{
+    used += length;
+    if(flush_always) output_flush();
+}
+
+/**
+ * バッファの内容を書き出してから、標準エラー出力にエラーを表示して終了します。
+ * それまでの出力より先にエラーが表示されないようにするためです。
+ */
+void output_error(const char* format, ...)
+{
+    va_list args;
+    output_flush();
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    exit(EXIT_FAILURE);
+}
@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Record.h"
+#include "Object.h"
+#include "Output.h"
+
+/**
+ * エラー文のヘルパー関数です。
+ */
+static void error(const char* string) {
+    output_error("%s\n", string);
+}
+
+/**
+ * コンストラクタです。fieldsは宣言した順のフィールドの名前です。
+ */
+Shape* newShape(const char* name, int field_count, const char** fields)
+{
+    Shape* self = malloc(sizeof(Shape));
+    if(self == NULL) error("Runtime Error: Failed to make Shape.\n");
+    self->name = name;
+    self->field_count = field_count;
+    self->fields = fields;
+    return self;
+}
+
+/**
+ * フィールドの位置を返します。フィールドがなければ-1を返します。
+ */
+int shape_slot(Shape* self, const char* field)
+{
+    for(int index = 0; index < self->field_count; index++)
+        if(strcmp(self->fields[index], field) == 0) return index;
+    return -1;
+}
+
+/**
+ * 形のフィールドを持つレコードを作成します。
+ * フィールドの値は形と同じ領域に確保します。
+ */
+Record* newRecord(Shape* shape)
+{
+    Record* self = malloc(sizeof(Record) + sizeof(Object*) * shape->field_count);
+    if(self == NULL) error("Runtime Error: Failed to make Record.\n");
+    self->shape = shape;
+    for(int index = 0; index < shape->field_count; index++) self->slots[index] = NULL;
+    return self;
+}
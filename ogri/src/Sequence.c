@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "Deque.h"
+#include "Evaluate.h"
+#include "Iterator.h"
+#include "List.h"
+#include "Object.h"
+#include "Output.h"
+#include "Sequence.h"
+#include "TypedArray.h"
+
+/**
+ * コンストラクタです。
+ */
+Sequence* newSequence(SequenceKind kind, Object* function, Object* source, long count)
+{
+    Sequence* self = malloc(sizeof(Sequence));
+    if(self == NULL) {
+        output_error("Runtime Error: cannot make sequence...\n");
+    }
+    self->kind = kind;
+    self->function = function;
+    self->source = source;
+    self->count = count;
+    return self;
+}
+
+/**
+ * repeatで値を取り出せるオブジェクトかどうかその真偽を返します。
+ */
+bool is_iterable(Object* obj)
+{
+    if(obj == NULL) return false;
+    return obj->type == LIST || is_typed_array(obj) || obj->type == DEQUE || obj->type == RANGE ||
+            obj->type == GENERATOR || obj->type == SEQUENCE;
+}
+
+/**
+ * 関数に値を1つ渡して呼び出します。
+ */
+static Object* apply(Object* function, Object* value)
+{
+    List* args = newList(Object*);
+    add(args, &value);
+    Object* result = call_object(function, args);
+    dList(args);
+    return result;
+}
+
+/**
+ * 列の長さを返します。limitが0以上の場合はlimitより先を数えません。
+ * 長さの分かっている列はその値を使い、分からない列だけ実際に値を取り出して数えます。
+ */
+static long length_of(Object* obj, long limit)
+{
+    long length;
+    if(obj->type == LIST) {
+        length = getSize(obj->list);
+    } else if(obj->type == RANGE) {
+        length = obj->range->length;
+    } else if(obj->type == DEQUE) {
+        length = obj->deque->count;
+    } else if(is_typed_array(obj)) {
+        length = obj->array->length;
+    } else if(obj->type == SEQUENCE && obj->sequence->kind == SEQUENCE_MAP) {
+        return length_of(obj->sequence->source, limit);
+    } else if(obj->type == SEQUENCE && obj->sequence->kind == SEQUENCE_TAKE) {
+        long count = obj->sequence->count;
+        return length_of(obj->sequence->source, (limit >= 0 && limit < count) ? limit : count);
+    } else {
+        length = 0;
+        Iterator* iterator = newIterator(obj);
+        while((limit < 0 || length < limit) && has_next(iterator)) {
+            next(iterator);
+            length++;
+        }
+        dIterator(iterator);
+    }
+    return (limit >= 0 && length > limit) ? limit : length;
+}
+
+/**
+ * 元をたどるとジェネレーターのように1度しか値を取り出せない列であるか判定します。
+ */
+static bool is_one_shot(Object* obj)
+{
+    if(obj->type == SEQUENCE) return is_one_shot(obj->sequence->source);
+    return obj->type == GENERATOR;
+}
+
+/**
+ * 列の長さを返します。
+ * 1度しか値を取り出せない列は、数えた後も値を取り出せるように列自身をリストに変換してから数えます。
+ */
+long sequence_length(Object* self)
+{
+    if(is_one_shot(self)) return getSize(obj_materialize(self));
+    return length_of(self, -1);
+}
+
+/**
+ * 列の次の値があるかどうかその真偽を返します。
+ * filterの場合は条件を満たす値が見つかるまで元の列を進め、その値を保持しておきます。
+ */
+bool sequence_has_next(Iterator* iterator)
+{
+    Sequence* self = iterator->list->sequence;
+    switch(self->kind) {
+        case SEQUENCE_MAP:
+            return has_next(iterator->source);
+        case SEQUENCE_TAKE:
+            return iterator->current + 1 < self->count && has_next(iterator->source);
+        case SEQUENCE_FILTER:
+            if(iterator->pending != NULL) return true;
+            while(has_next(iterator->source)) {
+                Object* value = next(iterator->source);
+                if(is_true(apply(self->function, value))) {
+                    iterator->pending = value;
+                    return true;
+                }
+            }
+            return false;
+    }
+    return false;
+}
+
+/**
+ * 列の次の値を計算して返します。
+ */
+Object* sequence_next(Iterator* iterator)
+{
+    Sequence* self = iterator->list->sequence;
+    switch(self->kind) {
+        case SEQUENCE_MAP:
+            return apply(self->function, next(iterator->source));
+        case SEQUENCE_TAKE:
+            return next(iterator->source);
+        case SEQUENCE_FILTER: {
+            Object* value = iterator->pending;
+            iterator->pending = NULL;
+            return value;
+        }
+    }
+    return NULL;
+}
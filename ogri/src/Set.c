@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "Set.h"
+#include "List.h"
+#include "Map.h"
+#include "Object.h"
+#include "Output.h"
+
+#define WORD_BITS 64
+
+/**
+ * エラー文のヘルパー関数です。
+ */
+static void error(const char* string) {
+    output_error("%s\n", string);
+}
+
+/**
+ * ビット列で表せる整数であれば、その値を設定します。
+ * 整数と等しい実数も、マップと同じく等しい整数として扱います。
+ */
+static bool small_integer(Object* value, long* integer)
+{
+    if(value->type == INTEGER) *integer = value->integer;
+    else if(value->type == FLOAT && value->real >= 0 && value->real < SET_BITSET_LIMIT &&
+            (double)(long)value->real == value->real) *integer = (long)value->real;
+    else return false;
+    return *integer >= 0 && *integer < SET_BITSET_LIMIT;
+}
+
+/**
+ * ビット列を指定した語数まで広げます。
+ */
+static void grow(Set* self, int word_count)
+{
+    if(word_count <= self->word_count) return;
+    unsigned long* words = realloc(self->words, sizeof(unsigned long) * word_count);
+    if(words == NULL) error("Runtime Error: Failed to resize a Set.\n");
+    memset(words + self->word_count, 0, sizeof(unsigned long) * (word_count - self->word_count));
+    self->words = words;
+    self->word_count = word_count;
+}
+
+/**
+ * ビット列の要素数を数え直します。
+ */
+static void recount(Set* self)
+{
+    int count = 0;
+    for(int index = 0; index < self->word_count; index++)
+        count += __builtin_popcountl(self->words[index]);
+    self->count = count;
+}
+
+/**
+ * ビット列の要素をマップに移し、以降はマップで表します。
+ */
+static void to_table(Set* self)
+{
+    self->table = newMap();
+    for(int index = 0; index < self->word_count; index++) {
+        for(unsigned long word = self->words[index]; word != 0; word &= word - 1) {
+            Object* value = new_int((long)index * WORD_BITS + __builtin_ctzl(word));
+            map_set(self->table, value, value);
+        }
+    }
+    free(self->words);
+    self->words = NULL;
+    self->word_count = 0;
+}
+
+/**
+ * コンストラクタです。
+ */
+Set* newSet(void)
+{
+    Set* self = malloc(sizeof(Set));
+    if(self == NULL) error("Runtime Error: Failed to make Set.\n");
+    self->words = NULL;
+    self->word_count = 0;
+    self->count = 0;
+    self->table = NULL;
+    return self;
+}
+
+/**
+ * 値を加え、新しく加えたかどうかを返します。
+ * 値はmap_is_keyで判定できるものに限ります。
+ */
+bool set_add(Set* self, Object* value)
+{
+    long integer;
+    if(self->table == NULL) {
+        if(value->type == INTEGER && small_integer(value, &integer)) {
+            grow(self, (int)(integer / WORD_BITS) + 1);
+            unsigned long bit = 1UL << (integer % WORD_BITS);
+            if(self->words[integer / WORD_BITS] & bit) return false;
+            self->words[integer / WORD_BITS] |= bit;
+            self->count++;
+            return true;
+        }
+        to_table(self);
+    }
+    if(map_get(self->table, value) != NULL) return false;
+    map_set(self->table, value, value);
+    self->count = self->table->count;
+    return true;
+}
+
+/**
+ * 値を含むかどうかを返します。
+ */
+bool set_has(Set* self, Object* value)
+{
+    if(self->table != NULL) return map_get(self->table, value) != NULL;
+    long integer;
+    if(!small_integer(value, &integer) || integer / WORD_BITS >= self->word_count) return false;
+    return (self->words[integer / WORD_BITS] >> (integer % WORD_BITS)) & 1;
+}
+
+/**
+ * 値を取り除き、取り除いたかどうかを返します。
+ */
+bool set_remove(Set* self, Object* value)
+{
+    if(self->table != NULL) {
+        bool removed = map_remove(self->table, value);
+        self->count = self->table->count;
+        return removed;
+    }
+    long integer;
+    if(!set_has(self, value) || !small_integer(value, &integer)) return false;
+    self->words[integer / WORD_BITS] &= ~(1UL << (integer % WORD_BITS));
+    self->count--;
+    return true;
+}
+
+/**
+ * ビット列の集合を複製します。
+ */
+static Set* copy_bitset(Set* source, int word_count)
+{
+    Set* result = newSet();
+    grow(result, word_count);
+    if(word_count > 0) memcpy(result->words, source->words, sizeof(unsigned long) * word_count);
+    recount(result);
+    return result;
+}
+
+/**
+ * 和集合を返します。
+ */
+Set* set_union(Set* left, Set* right)
+{
+    if(left->table == NULL && right->table == NULL) {
+        Set* longer = (left->word_count >= right->word_count) ? left : right;
+        Set* shorter = (longer == left) ? right : left;
+        Set* result = copy_bitset(longer, longer->word_count);
+        for(int index = 0; index < shorter->word_count; index++)
+            result->words[index] |= shorter->words[index];
+        recount(result);
+        return result;
+    }
+    Set* result = newSet();
+    List* items = set_items(left);
+    for(int index = 0; index < getSize(items); index++) {
+        Object* value;
+        getAt(items, index, Object*, &value);
+        set_add(result, value);
+    }
+    dList(items);
+    items = set_items(right);
+    for(int index = 0; index < getSize(items); index++) {
+        Object* value;
+        getAt(items, index, Object*, &value);
+        set_add(result, value);
+    }
+    dList(items);
+    return result;
+}
+
+/**
+ * leftの要素のうち、rightに含まれるかどうかがkeepと一致するものの集合を返します。
+ */
+static Set* filter_items(Set* left, Set* right, bool keep)
+{
+    Set* result = newSet();
+    List* items = set_items(left);
+    for(int index = 0; index < getSize(items); index++) {
+        Object* value;
+        getAt(items, index, Object*, &value);
+        if(set_has(right, value) == keep) set_add(result, value);
+    }
+    dList(items);
+    return result;
+}
+
+/**
+ * 積集合を返します。
+ */
+Set* set_intersection(Set* left, Set* right)
+{
+    if(left->table == NULL && right->table == NULL) {
+        int word_count = (left->word_count < right->word_count) ? left->word_count : right->word_count;
+        Set* result = copy_bitset(left, word_count);
+        for(int index = 0; index < word_count; index++)
+            result->words[index] &= right->words[index];
+        recount(result);
+        return result;
+    }
+    return filter_items(left, right, true);
+}
+
+/**
+ * 差集合を返します。
+ */
+Set* set_difference(Set* left, Set* right)
+{
+    if(left->table == NULL && right->table == NULL) {
+        Set* result = copy_bitset(left, left->word_count);
+        int word_count = (left->word_count < right->word_count) ? left->word_count : right->word_count;
+        for(int index = 0; index < word_count; index++)
+            result->words[index] &= ~right->words[index];
+        recount(result);
+        return result;
+    }
+    return filter_items(left, right, false);
+}
+
+/**
+ * 要素を並べたリストを返します。
+ * ビット列で表す場合は小さい順に、マップで表す場合は加えた順に並べます。
+ */
+List* set_items(Set* self)
+{
+    if(self->table != NULL) return map_keys(self->table);
+
+    List* items = newList(Object*);
+    reserve(items, self->count);
+    for(int index = 0; index < self->word_count; index++) {
+        for(unsigned long word = self->words[index]; word != 0; word &= word - 1) {
+            Object* value = new_int((long)index * WORD_BITS + __builtin_ctzl(word));
+            add(items, &value);
+        }
+    }
+    return items;
+}
@@ -0,0 +1,465 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Ast.h"
+#include "List.h"
+#include "Object.h"
+#include "TypeInference.h"
+
+typedef struct {
+    const char* name;
+    StaticType type;
+} TypeEntry;
+
+// 変数名から型への対応です。含まれない変数の型はTYPE_ANYとして扱います。
+typedef List TypeState;
+
+static void infer(Ast*, TypeState*, bool);
+
+/**
+ * 変数の型を返します。
+ */
+static StaticType lookup(TypeState* state, const char* name)
+{
+    for(int index = 0; index < getSize(state); index++) {
+        TypeEntry* entry = getRef(state, index);
+        if(strcmp(entry->name, name) == 0) return entry->type;
+    }
+    return TYPE_ANY;
+}
+
+/**
+ * 変数の型を設定します。
+ */
+static void assign_type(TypeState* state, const char* name, StaticType type)
+{
+    for(int index = 0; index < getSize(state); index++) {
+        TypeEntry* entry = getRef(state, index);
+        if(strcmp(entry->name, name) != 0) continue;
+        if(type == TYPE_ANY) removeAt(state, index);
+        else entry->type = type;
+        return;
+    }
+    if(type == TYPE_ANY) return;
+    TypeEntry entry = { name, type };
+    add(state, &entry);
+}
+
+/**
+ * 状態を複製します。
+ */
+static TypeState* copy_state(TypeState* state)
+{
+    TypeState* copy = newList(TypeEntry);
+    clone(copy, state);
+    return copy;
+}
+
+/**
+ * 2つの状態を合流させます。
+ * どちらでも同じ型の変数だけが型を保ちます。
+ */
+static TypeState* join_states(TypeState* a, TypeState* b)
+{
+    TypeState* joined = newList(TypeEntry);
+    for(int index = 0; index < getSize(a); index++) {
+        TypeEntry* entry = getRef(a, index);
+        if(lookup(b, entry->name) == entry->type) add(joined, entry);
+    }
+    return joined;
+}
+
+/**
+ * 状態の内容を別の状態で置き換え、置き換えた状態を解放します。
+ */
+static void replace_state(TypeState* state, TypeState* other)
+{
+    while(getSize(state) > 0) removeAt(state, getSize(state) - 1);
+    clone(state, other);
+    dList(other);
+}
+
+/**
+ * 1つの値からなる値リストであればその値を返します。
+ */
+static Ast* single_value(Ast* node)
+{
+    if(node != NULL && node->kind == AST_VALUE_LIST && node->value_list.next == NULL)
+        return node->value_list.first;
+    return node;
+}
+
+static bool is_number_type(StaticType type)
+{
+    return type == TYPE_INTEGER || type == TYPE_FLOAT;
+}
+
+static bool is_arithmetic(Operator op)
+{
+    return op == OP_ADD || op == OP_SUB || op == OP_MUL || op == OP_DIV || op == OP_MOD;
+}
+
+static bool is_comparison(Operator op)
+{
+    return op == OP_EQ || op == OP_NE || op == OP_LT || op == OP_GT || op == OP_LE || op == OP_GE;
+}
+
+/**
+ * 式の型を推論します。
+ */
+static StaticType type_of(Ast* node, TypeState* state)
+{
+    if(node == NULL) return TYPE_ANY;
+    switch(node->kind) {
+        case AST_INTEGER:   return TYPE_INTEGER;
+        case AST_FLOAT:     return TYPE_FLOAT;
+        case AST_STRING:
+        case AST_FSTRING:   return TYPE_STRING;
+        case AST_BOOL:      return TYPE_BOOL;
+        case AST_SLICE:     return TYPE_LIST;
+        case AST_IDENTIFIER:
+            return lookup(state, node->identifier.name);
+        case AST_CONSTANT:
+            return (node->constant.value->type == LIST) ? TYPE_LIST : TYPE_ANY;
+        case AST_CACHED:
+            return type_of(node->cached.expr, state);
+        case AST_UNBOXED:
+            return node->unboxed.type;
+        case AST_VALUE_LIST:
+            if(node->value_list.next != NULL) return TYPE_LIST;
+            return type_of(node->value_list.first, state);
+        case AST_FUNC_CALL:
+            return (strcmp(node->func_call.name->identifier.name, "len") == 0) ? TYPE_INTEGER : TYPE_ANY;
+        case AST_UNARY: {
+            if(node->unary.opcode == OP_NOT) return TYPE_BOOL;
+            StaticType type = type_of(node->unary.expr, state);
+            return is_number_type(type) ? type : TYPE_ANY;
+        }
+        case AST_BINOP: {
+            Operator op = node->binop.opcode;
+            StaticType left = type_of(node->binop.left, state);
+            StaticType right = type_of(node->binop.right, state);
+            if(is_comparison(op)) return TYPE_BOOL;
+            if(op == OP_AND || op == OP_OR) return (left == right) ? left : TYPE_ANY;
+            if(op == OP_ADD && left == TYPE_STRING && right == TYPE_STRING) return TYPE_STRING;
+            if(!is_arithmetic(op) || !is_number_type(left) || !is_number_type(right)) return TYPE_ANY;
+            return (left == TYPE_INTEGER && right == TYPE_INTEGER) ? TYPE_INTEGER : TYPE_FLOAT;
+        }
+        default:
+            return TYPE_ANY;
+    }
+}
+
+/**
+ * 数値として計算できる式であるか判定します。
+ * 型の分からない変数や配列の要素は数値であると仮定し、実行時に確かめます。
+ * 実行し直しても結果の変わらない式だけを対象とします。
+ */
+static bool is_number_tree(Ast* node, TypeState* state)
+{
+    switch(node->kind) {
+        case AST_INTEGER:
+        case AST_FLOAT:
+        case AST_ARGUMENT:
+            return true;
+        case AST_IDENTIFIER:
+        case AST_CACHED: {
+            StaticType type = type_of(node, state);
+            return type == TYPE_ANY || is_number_type(type);
+        }
+        case AST_ARRAY_ACCESS: {
+            Ast* index = node->array_access.index;
+            return index->kind == AST_IDENTIFIER || index->kind == AST_CACHED || is_number_tree(index, state);
+        }
+        case AST_UNARY:
+            return (node->unary.opcode == OP_ADD || node->unary.opcode == OP_SUB) &&
+                    is_number_tree(node->unary.expr, state);
+        case AST_BINOP:
+            return is_arithmetic(node->binop.opcode) &&
+                    is_number_tree(node->binop.left, state) && is_number_tree(node->binop.right, state);
+        default:
+            return false;
+    }
+}
+
+/**
+ * 数値であることを示すものを含むか判定します。
+ * 数値の定数、数値と推論した変数、数値にしか使えない演算子を含む式が該当します。
+ */
+static bool has_number_evidence(Ast* node, TypeState* state)
+{
+    switch(node->kind) {
+        case AST_INTEGER:
+        case AST_FLOAT:
+            return true;
+        case AST_IDENTIFIER:
+        case AST_CACHED:
+            return is_number_type(type_of(node, state));
+        case AST_UNARY:
+            return node->unary.opcode == OP_SUB || has_number_evidence(node->unary.expr, state);
+        case AST_BINOP:
+            if(node->binop.opcode != OP_ADD && is_arithmetic(node->binop.opcode)) return true;
+            return has_number_evidence(node->binop.left, state) || has_number_evidence(node->binop.right, state);
+        default:
+            return false;
+    }
+}
+
+/**
+ * 式を数値のまま計算できるか判定し、できる場合は結果の型を返します。
+ */
+static bool is_specializable(Ast* node, TypeState* state, StaticType* type)
+{
+    if(node->kind == AST_BINOP && is_comparison(node->binop.opcode)) {
+        Ast* left = node->binop.left;
+        Ast* right = node->binop.right;
+        *type = TYPE_BOOL;
+        return is_number_tree(left, state) && is_number_tree(right, state) &&
+                (has_number_evidence(left, state) || has_number_evidence(right, state));
+    }
+    bool is_operation = (node->kind == AST_BINOP || node->kind == AST_UNARY);
+    *type = type_of(node, state);
+    return is_operation && is_number_tree(node, state) && has_number_evidence(node, state);
+}
+
+/**
+ * 数値だけで計算できる式を、数値のまま計算する式に置き換えます。
+ */
+static void specialize(Ast** slot, TypeState* state, bool rewrite)
+{
+    Ast* node = *slot;
+    if(!rewrite || node == NULL) return;
+
+    StaticType type;
+    if(is_specializable(node, state, &type)) {
+        *slot = ast_unboxed(node, type);
+        return;
+    }
+    switch(node->kind) {
+        case AST_BINOP:
+            specialize(&node->binop.left, state, rewrite);
+            specialize(&node->binop.right, state, rewrite);
+            break;
+        case AST_UNARY:
+            specialize(&node->unary.expr, state, rewrite);
+            break;
+        case AST_VALUE_LIST:
+            specialize(&node->value_list.first, state, rewrite);
+            specialize(&node->value_list.next, state, rewrite);
+            break;
+        case AST_FUNC_CALL:
+            specialize(&node->func_call.args, state, rewrite);
+            break;
+        case AST_ARRAY_ACCESS:
+            specialize(&node->array_access.index, state, rewrite);
+            break;
+        case AST_FIELD:
+            specialize(&node->field.object, state, rewrite);
+            break;
+        case AST_SLICE:
+            specialize(&node->slice.index, state, rewrite);
+            break;
+        case AST_RANGE:
+            specialize(&node->range.from, state, rewrite);
+            specialize(&node->range.end, state, rewrite);
+            break;
+        case AST_FSTRING:
+            specialize(&node->fstring.parts, state, rewrite);
+            break;
+        case AST_FSTRING_PARTS:
+            specialize(&node->fstring_parts.first, state, rewrite);
+            specialize(&node->fstring_parts.next, state, rewrite);
+            break;
+        case AST_INLINE: {
+            // 展開した式の中では仮引数の型は分かりません。
+            TypeState* local = newList(TypeEntry);
+            specialize(&node->inline_call.call->func_call.args, state, rewrite);
+            specialize(&node->inline_call.expr, local, rewrite);
+            dList(local);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/**
+ * 代入文の左辺の変数に型を設定します。
+ */
+static void infer_assign(Ast* node, TypeState* state)
+{
+    Ast* left = node->assign.left;
+    if(left->kind == AST_IDENTIFIER) {
+        StaticType type = (node->assign.right->kind == AST_MAP) ? TYPE_ANY : TYPE_LIST;
+        if(!node->assign.is_are) {
+            // 要素が1つのリストはその要素として代入されます。
+            type = type_of(single_value(node->assign.right), state);
+            if(type == TYPE_LIST) type = TYPE_ANY;
+        }
+        assign_type(state, left->identifier.name, type);
+    } else if(left->kind == AST_IDENTIFIER_LIST) {
+        for(Ast* item = left; item != NULL; item = item->identifier_list.next) {
+            Ast* target = (item->kind == AST_IDENTIFIER_LIST) ? item->identifier_list.first : item;
+            assign_type(state, target->identifier.name, TYPE_ANY);
+            if(item->kind != AST_IDENTIFIER_LIST) break;
+        }
+    }
+}
+
+/**
+ * when文の各分岐を推論し、分岐後の状態を合流させます。
+ */
+static void infer_when(Ast* node, TypeState* state, bool rewrite)
+{
+    List* blocks = newList(Ast*);
+    specialize(&node->when_stmt.cond, state, rewrite);
+    add(blocks, &node->when_stmt.then_block);
+    Ast* other = node->when_stmt.other_block;
+    for(Ast* clause = node->when_stmt.otherwhen_list; clause != NULL; clause = clause->otherwhen.next) {
+        if(clause->kind == AST_BLOCK) {
+            other = clause;
+            break;
+        }
+        specialize(&clause->otherwhen.cond, state, rewrite);
+        add(blocks, &clause->otherwhen.block);
+    }
+    if(other != NULL) add(blocks, &other);
+
+    TypeState* joined = (other == NULL) ? copy_state(state) : NULL;
+    for(int index = 0; index < getSize(blocks); index++) {
+        Ast* block;
+        getAt(blocks, index, Ast*, &block);
+        TypeState* branch = copy_state(state);
+        infer(block, branch, rewrite);
+        if(joined == NULL) {
+            joined = branch;
+        } else {
+            TypeState* next = join_states(joined, branch);
+            dList(joined);
+            dList(branch);
+            joined = next;
+        }
+    }
+    dList(blocks);
+    replace_state(state, joined);
+}
+
+/**
+ * ループの本体を繰り返し推論し、ループの先頭で成り立つ状態を求めます。
+ * 求めた状態で条件と本体を1度だけ置き換えます。
+ */
+static void infer_loop(Ast* node, TypeState* state, bool rewrite)
+{
+    Ast** cond = NULL;
+    Ast* block;
+    const char* variable = NULL;
+    StaticType variable_type = TYPE_ANY;
+    if(node->kind == AST_REPEAT) {
+        Ast* collection = node->repeat_stmt.collection;
+        specialize(&node->repeat_stmt.collection, state, rewrite);
+        block = node->repeat_stmt.block;
+        variable = node->repeat_stmt.identifier->identifier.name;
+        collection = single_value(collection);
+        if(collection != NULL && collection->kind == AST_FUNC_CALL &&
+            strcmp(collection->func_call.name->identifier.name, "range") == 0)
+            variable_type = TYPE_INTEGER;
+    } else {
+        cond = &node->repeat_until_stmt.cond;
+        block = node->repeat_until_stmt.block;
+    }
+
+    TypeState* head = copy_state(state);
+    while(1) {
+        TypeState* body = copy_state(head);
+        if(variable != NULL) assign_type(body, variable, variable_type);
+        infer(block, body, false);
+        TypeState* next = join_states(head, body);
+        dList(body);
+        bool is_stable = (getSize(next) == getSize(head));
+        dList(head);
+        head = next;
+        if(is_stable) break;
+    }
+
+    if(cond != NULL) specialize(cond, head, rewrite);
+    TypeState* body = copy_state(head);
+    if(variable != NULL) {
+        assign_type(body, variable, variable_type);
+        assign_type(head, variable, TYPE_ANY);
+    }
+    infer(block, body, rewrite);
+    dList(body);
+    replace_state(state, head);
+}
+
+/**
+ * 文を順に推論します。
+ * rewriteが偽の場合は型の推論だけを行い、抽象木は置き換えません。
+ */
+static void infer(Ast* node, TypeState* state, bool rewrite)
+{
+    if(node == NULL) return;
+    switch(node->kind) {
+        case AST_STATEMENTS:
+            infer(node->list.first, state, rewrite);
+            infer(node->list.next, state, rewrite);
+            break;
+        case AST_BLOCK:
+            infer(node->block.statements, state, rewrite);
+            break;
+        case AST_ASSIGN:
+            specialize(&node->assign.right, state, rewrite);
+            if(node->assign.left->kind == AST_ARRAY_ACCESS)
+                specialize(&node->assign.left->array_access.index, state, rewrite);
+            if(node->assign.left->kind == AST_FIELD)
+                specialize(&node->assign.left->field.object, state, rewrite);
+            infer_assign(node, state);
+            break;
+        case AST_WHEN:
+            infer_when(node, state, rewrite);
+            break;
+        case AST_SWITCH:
+            infer_when(node->switch_stmt.chain, state, rewrite);
+            break;
+        case AST_REPEAT:
+        case AST_REPEAT_UNTIL:
+            infer_loop(node, state, rewrite);
+            break;
+        case AST_FUNC_DEF:
+            assign_type(state, node->func_def.name->identifier.name, TYPE_ANY);
+            if(rewrite) {
+                TypeState* local = newList(TypeEntry);
+                infer(node->func_def.body, local, rewrite);
+                dList(local);
+            }
+            break;
+        case AST_RECORD_DEF:
+            assign_type(state, node->record_def.name->identifier.name, TYPE_ANY);
+            break;
+        case AST_RETURN:
+            // 末尾呼び出しは関数呼び出しのまま残す必要があるため、引数だけを置き換えます。
+            if(node->return_stmt.is_tail_call)
+                specialize(&node->return_stmt.expr->func_call.args, state, rewrite);
+            else
+                specialize(&node->return_stmt.expr, state, rewrite);
+            break;
+        case AST_YIELD:
+            specialize(&node->yield_stmt.expr, state, rewrite);
+            break;
+        case AST_FUNC_CALL:
+            specialize(&node->func_call.args, state, rewrite);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * プログラム全体と各関数の本体の型を推論し、数値のまま計算できる式を置き換えます。
+ */
+void infer_types(Ast* root)
+{
+    TypeState* state = newList(TypeEntry);
+    infer(root, state, true);
+    dList(state);
+}
@@ -0,0 +1,362 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "TypedArray.h"
+#include "Output.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define INIT_CAPACITY 8
+#define ELEMENT_SIZE (sizeof(long) > sizeof(double) ? sizeof(long) : sizeof(double))
+
+/**
+ * エラー文のヘルパー関数です。
+ */
+static void error(const char* string) {
+    output_error("%s\n", string);
+}
+
+/**
+ * コンストラクタです。
+ * 指定した数の要素を追加できる領域を確保します。
+ */
+TypedArray* newTypedArray(long capacity)
+{
+    TypedArray* self = malloc(sizeof(TypedArray));
+    if(self == NULL) error("Runtime Error: Failed to make TypedArray.\n");
+    if(capacity < INIT_CAPACITY) capacity = INIT_CAPACITY;
+    self->integers = malloc(ELEMENT_SIZE * capacity);
+    if(self->integers == NULL) error("Runtime Error: Failed to make TypedArray.\n");
+    self->length = 0;
+    self->capacity = capacity;
+    return self;
+}
+
+/**
+ * 指定した数の要素を格納できるように領域を広げます。
+ */
+void typed_array_reserve(TypedArray* self, long capacity)
+{
+    if(capacity <= self->capacity) return;
+    long new_capacity = self->capacity * 2;
+    if(new_capacity < capacity) new_capacity = capacity;
+    long* integers = realloc(self->integers, ELEMENT_SIZE * new_capacity);
+    if(integers == NULL) error("Runtime Error: Failed to resize a TypedArray.\n");
+    self->integers = integers;
+    self->capacity = new_capacity;
+}
+
+/**
+ * 整数の配列の末尾に値を追加します。
+ */
+void typed_array_push_integer(TypedArray* self, long value)
+{
+    typed_array_reserve(self, self->length + 1);
+    self->integers[self->length++] = value;
+}
+
+/**
+ * 実数の配列の末尾に値を追加します。
+ */
+void typed_array_push_real(TypedArray* self, double value)
+{
+    typed_array_reserve(self, self->length + 1);
+    self->reals[self->length++] = value;
+}
+
+/**
+ * start番目からend番目の手前までの要素を複製した配列を返します。
+ */
+TypedArray* typed_array_slice(TypedArray* self, long start, long end)
+{
+    TypedArray* result = newTypedArray(end - start);
+    if(end > start) memcpy(result->integers, (char*)self->integers + ELEMENT_SIZE * start, ELEMENT_SIZE * (end - start));
+    result->length = end - start;
+    return result;
+}
+
+/*
+ * 以下の集計は、x86-64でAVX2が使える場合はAVX2の命令で4つの要素をまとめて計算し、それ以外では1つずつ計算します。
+ * AVX2が使えるかは実行時に調べるため、コンパイラの最適化の設定やビルドした環境に関わらずまとめて計算します。
+ * 実数の和はどちらの場合も4つの部分和に分けて同じ順序で足すため、結果は変わりません。
+ */
+
+#if defined(__x86_64__)
+
+/**
+ * 64ビットの整数どうしの積の下位64ビットを4つまとめて求めます。
+ * AVX2には64ビットの乗算がないため、32ビットずつに分けて掛けます。
+ */
+__attribute__((target("avx2")))
+static __m256i multiply_integers_avx2(__m256i a, __m256i b)
+{
+    __m256i low = _mm256_mul_epu32(a, b);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+
+/**
+ * 整数の配列の要素の和をAVX2で求めます。
+ */
+__attribute__((target("avx2")))
+static long sum_integers_avx2(const long* values, long length)
+{
+    __m256i totals = _mm256_setzero_si256();
+    long index = 0;
+    for(; index + 4 <= length; index += 4)
+        totals = _mm256_add_epi64(totals, _mm256_loadu_si256((const __m256i*)(values + index)));
+    unsigned long lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, totals);
+    unsigned long total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for(; index < length; index++) total += (unsigned long)values[index];
+    return (long)total;
+}
+
+/**
+ * 実数の配列の要素の和をAVX2で求めます。
+ */
+__attribute__((target("avx2")))
+static double sum_reals_avx2(const double* values, long length)
+{
+    __m256d totals = _mm256_setzero_pd();
+    long index = 0;
+    for(; index + 4 <= length; index += 4)
+        totals = _mm256_add_pd(totals, _mm256_loadu_pd(values + index));
+    double lanes[4];
+    _mm256_storeu_pd(lanes, totals);
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for(; index < length; index++) total += values[index];
+    return total;
+}
+
+/**
+ * 同じ長さの整数の配列の内積をAVX2で求めます。
+ */
+__attribute__((target("avx2")))
+static long dot_integers_avx2(const long* a, const long* b, long length)
+{
+    __m256i totals = _mm256_setzero_si256();
+    long index = 0;
+    for(; index + 4 <= length; index += 4) {
+        __m256i products = multiply_integers_avx2(_mm256_loadu_si256((const __m256i*)(a + index)), _mm256_loadu_si256((const __m256i*)(b + index)));
+        totals = _mm256_add_epi64(totals, products);
+    }
+    unsigned long lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, totals);
+    unsigned long total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    for(; index < length; index++) total += (unsigned long)a[index] * (unsigned long)b[index];
+    return (long)total;
+}
+
+/**
+ * 同じ長さの実数の配列の内積をAVX2で求めます。
+ * 積和を1つの命令で計算すると丸め方が変わるため、掛けてから足します。
+ */
+__attribute__((target("avx2")))
+static double dot_reals_avx2(const double* a, const double* b, long length)
+{
+    __m256d totals = _mm256_setzero_pd();
+    long index = 0;
+    for(; index + 4 <= length; index += 4)
+        totals = _mm256_add_pd(totals, _mm256_mul_pd(_mm256_loadu_pd(a + index), _mm256_loadu_pd(b + index)));
+    double lanes[4];
+    _mm256_storeu_pd(lanes, totals);
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for(; index < length; index++) total += a[index] * b[index];
+    return total;
+}
+
+/**
+ * 空でない整数の配列の最大値(is_maxが偽の場合は最小値)をAVX2で求めます。
+ */
+__attribute__((target("avx2")))
+static long extreme_integers_avx2(const long* values, long length, bool is_max)
+{
+    __m256i extremes = _mm256_set1_epi64x(values[0]);
+    long index = 0;
+    for(; index + 4 <= length; index += 4) {
+        __m256i current = _mm256_loadu_si256((const __m256i*)(values + index));
+        __m256i better = is_max ? _mm256_cmpgt_epi64(current, extremes) : _mm256_cmpgt_epi64(extremes, current);
+        extremes = _mm256_blendv_epi8(extremes, current, better);
+    }
+    long lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, extremes);
+    long extreme = lanes[0];
+    for(int lane = 1; lane < 4; lane++)
+        extreme = (is_max ? lanes[lane] > extreme : lanes[lane] < extreme) ? lanes[lane] : extreme;
+    for(; index < length; index++)
+        extreme = (is_max ? values[index] > extreme : values[index] < extreme) ? values[index] : extreme;
+    return extreme;
+}
+
+/**
+ * 空でない実数の配列の最大値(is_maxが偽の場合は最小値)をAVX2で求めます。
+ * maxpd・minpdはどちらかがNaNの場合に2つ目の値を返すため、1つずつ比べる場合と同じくNaNの要素は選ばれず、先頭がNaNの場合はNaNになります。
+ */
+__attribute__((target("avx2")))
+static double extreme_reals_avx2(const double* values, long length, bool is_max)
+{
+    __m256d extremes = _mm256_set1_pd(values[0]);
+    long index = 0;
+    for(; index + 4 <= length; index += 4) {
+        __m256d current = _mm256_loadu_pd(values + index);
+        extremes = is_max ? _mm256_max_pd(current, extremes) : _mm256_min_pd(current, extremes);
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, extremes);
+    double extreme = values[0];
+    for(int lane = 0; lane < 4; lane++)
+        extreme = (is_max ? lanes[lane] > extreme : lanes[lane] < extreme) ? lanes[lane] : extreme;
+    for(; index < length; index++)
+        extreme = (is_max ? values[index] > extreme : values[index] < extreme) ? values[index] : extreme;
+    return extreme;
+}
+
+#endif
+
+/**
+ * 整数の配列の要素の和を返します。
+ */
+long typed_array_sum_integers(TypedArray* self)
+{
+    const long* values = self->integers;
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2")) return sum_integers_avx2(values, self->length);
+#endif
+    unsigned long total = 0;
+    for(long index = 0; index < self->length; index++) total += (unsigned long)values[index];
+    return (long)total;
+}
+
+/**
+ * 実数の配列の要素の和を返します。
+ */
+double typed_array_sum_reals(TypedArray* self)
+{
+    const double* values = self->reals;
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2")) return sum_reals_avx2(values, self->length);
+#endif
+    double totals[4] = { 0, 0, 0, 0 };
+    long index = 0;
+    for(; index + 4 <= self->length; index += 4) {
+        totals[0] += values[index];
+        totals[1] += values[index + 1];
+        totals[2] += values[index + 2];
+        totals[3] += values[index + 3];
+    }
+    double total = (totals[0] + totals[1]) + (totals[2] + totals[3]);
+    for(; index < self->length; index++) total += values[index];
+    return total;
+}
+
+/**
+ * 同じ長さの整数の配列の内積を返します。
+ */
+long typed_array_dot_integers(TypedArray* left, TypedArray* right)
+{
+    const long* a = left->integers;
+    const long* b = right->integers;
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2")) return dot_integers_avx2(a, b, left->length);
+#endif
+    unsigned long total = 0;
+    for(long index = 0; index < left->length; index++) total += (unsigned long)a[index] * (unsigned long)b[index];
+    return (long)total;
+}
+
+/**
+ * 同じ長さの実数の配列の内積を返します。
+ */
+double typed_array_dot_reals(TypedArray* left, TypedArray* right)
+{
+    const double* a = left->reals;
+    const double* b = right->reals;
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2")) return dot_reals_avx2(a, b, left->length);
+#endif
+    double totals[4] = { 0, 0, 0, 0 };
+    long index = 0;
+    for(; index + 4 <= left->length; index += 4) {
+        totals[0] += a[index] * b[index];
+        totals[1] += a[index + 1] * b[index + 1];
+        totals[2] += a[index + 2] * b[index + 2];
+        totals[3] += a[index + 3] * b[index + 3];
+    }
+    double total = (totals[0] + totals[1]) + (totals[2] + totals[3]);
+    for(; index < left->length; index++) total += a[index] * b[index];
+    return total;
+}
+
+/**
+ * 空でない整数の配列の最大値(is_maxが偽の場合は最小値)を返します。
+ */
+static long extreme_integer(const long* values, long length, bool is_max)
+{
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2")) return extreme_integers_avx2(values, length, is_max);
+#endif
+    long extreme = values[0];
+    if(is_max) {
+        for(long index = 1; index < length; index++) extreme = (values[index] > extreme) ? values[index] : extreme;
+    } else {
+        for(long index = 1; index < length; index++) extreme = (values[index] < extreme) ? values[index] : extreme;
+    }
+    return extreme;
+}
+
+/**
+ * 空でない実数の配列の最大値(is_maxが偽の場合は最小値)を返します。
+ */
+static double extreme_real(const double* values, long length, bool is_max)
+{
+#if defined(__x86_64__)
+    if(__builtin_cpu_supports("avx2")) return extreme_reals_avx2(values, length, is_max);
+#endif
+    double extreme = values[0];
+    if(is_max) {
+        for(long index = 1; index < length; index++) extreme = (values[index] > extreme) ? values[index] : extreme;
+    } else {
+        for(long index = 1; index < length; index++) extreme = (values[index] < extreme) ? values[index] : extreme;
+    }
+    return extreme;
+}
+
+/**
+ * 空でない整数の配列で、最も大きい(is_maxが偽の場合は最も小さい)要素のうち最初のものの位置を返します。
+ * 最大値または最小値を求めてから、その値の位置を探します。
+ */
+long typed_array_extreme_integers(TypedArray* self, bool is_max)
+{
+    const long* values = self->integers;
+    long extreme = extreme_integer(values, self->length, is_max);
+    long index = 0;
+    while(values[index] != extreme) index++;
+    return index;
+}
+
+/**
+ * 空でない実数の配列で、最も大きい(is_maxが偽の場合は最も小さい)要素のうち最初のものの位置を返します。
+ * 先頭がNaNの場合は先頭の位置を返します。
+ */
+long typed_array_extreme_reals(TypedArray* self, bool is_max)
+{
+    const double* values = self->reals;
+    double extreme = extreme_real(values, self->length, is_max);
+    for(long index = 0; index < self->length; index++)
+        if(values[index] == extreme) return index;
+    return 0;
+}
+
+/**
+ * デストラクタです。
+ */
+void dTypedArray(TypedArray* self)
+{
+    if(self == NULL) return;
+    free(self->integers);
+    free(self);
+}
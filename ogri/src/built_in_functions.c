@@ -1,9 +1,20 @@
 #include <stdio.h>
 #include <string.h>
 #include "built_in_functions.h"
+#include "Deque.h"
 #include "Environment.h"
+#include "Evaluate.h"
+#include "Heap.h"
+#include "Iterator.h"
 #include "List.h"
+#include "Map.h"
+#include "Memo.h"
+#include "NumberFormat.h"
 #include "Object.h"
+#include "Output.h"
+#include "Sequence.h"
+#include "Set.h"
+#include "TypedArray.h"
 
 static BuiltinDef builtins[] = {
     {"say", builtin_say},
@@ -14,6 +25,35 @@ static BuiltinDef builtins[] = {
     {"len", builtin_len},
     {"push", builtin_push},
     {"pop", builtin_pop},
+    {"map", builtin_map},
+    {"filter", builtin_filter},
+    {"reduce", builtin_reduce},
+    {"take", builtin_take},
+    {"dict", builtin_dict},
+    {"has", builtin_has},
+    {"keys", builtin_keys},
+    {"remove", builtin_remove},
+    {"set", builtin_set},
+    {"add", builtin_add},
+    {"union", builtin_union},
+    {"intersection", builtin_intersection},
+    {"difference", builtin_difference},
+    {"heap", builtin_heap},
+    {"heap_push", builtin_heap_push},
+    {"heap_pop", builtin_heap_pop},
+    {"heap_peek", builtin_heap_peek},
+    {"deque", builtin_deque},
+    {"push_front", builtin_push_front},
+    {"pop_front", builtin_pop_front},
+    {"int_array", builtin_int_array},
+    {"float_array", builtin_float_array},
+    {"sum", builtin_sum},
+    {"mean", builtin_mean},
+    {"min", builtin_min},
+    {"max", builtin_max},
+    {"argmin", builtin_argmin},
+    {"argmax", builtin_argmax},
+    {"dot", builtin_dot},
     {NULL, NULL}
 };
 
@@ -30,6 +70,17 @@ void set_builtins(Environment* env)
     }
 }
 
+/**
+ * 名前からビルトイン関数の本体を返します。ビルトイン関数でない場合はNULLを返します。
+ */
+built_in_function find_builtin(const char* name)
+{
+    for(int index = 0; builtins[index].name != NULL; index++) {
+        if(strcmp(builtins[index].name, name) == 0) return builtins[index].func;
+    }
+    return NULL;
+}
+
 /**
  * sayの本体です。
  * 第2引数によって最後に改行するか否かを決めます。
@@ -37,7 +88,7 @@ void set_builtins(Environment* env)
 static Object* internal_print(List* args, bool newline)
 {
     if(args == NULL) {
-        if(newline) printf("\n");
+        if(newline) output_char('\n');
         return new_int(0);
     }
     int len = 0;
@@ -46,21 +97,25 @@ static Object* internal_print(List* args, bool newline)
         Object* arg;
         getAt(args, index, Object*, &arg);
 
-        char* string = obj_toString(arg);
-        for(int index = 0; string[index] != '\0'; index++) {
-            if(string[index] == '\\' && string[index+1] == 'n') {
-                putchar('\n');
-                index++;
-            } else putchar(string[index]);
+        if(arg != NULL && arg->type == STRING) {
+            output_string(arg->string);
+            len += strlen(arg->string);
+        } else if(arg != NULL && (arg->type == INTEGER || arg->type == FLOAT)) {
+            char* buffer = output_reserve(NUMBER_BUFFER_SIZE);
+            int length = (arg->type == INTEGER) ? format_long(buffer, arg->integer) : format_double(buffer, arg->real);
+            output_commit(length);
+            len += length;
+        } else {
+            char* string = obj_toString(arg);
+            output_string(string);
+            len += strlen(string);
+            free(string);
         }
-        len += strlen(string);
-        free(string);
 
-        if(index < size - 1) printf(" ");
+        if(index < size - 1) output_char(' ');
     }
-    if(newline) printf("\n");
+    if(newline) output_char('\n');
 
-    fflush(stdout);
     return new_int((long)len);
 }
 
@@ -103,11 +158,17 @@ Object* builtin_to_int(List* args)
  * 入力を受け付けます。
  * 空白で複数の入力を受け付けます。
  * 複数の入力を受け取った場合はその入力をのリストを返します。
+ * 変換した値が全て整数か全て実数の場合は型付き配列を返します。
  */
 Object* builtin_listen(List* args)
 {
-    char buffer[1<<16];
-    if(fgets(buffer, sizeof(buffer), stdin) == NULL) return new_string("");
+    char* buffer = NULL;
+    size_t buffer_size = 0;
+    output_flush();
+    if(getline(&buffer, &buffer_size, stdin) < 0) {
+        free(buffer);
+        return new_string("");
+    }
 
     buffer[strcspn(buffer, "\n")] = '\0';
 
@@ -117,6 +178,7 @@ Object* builtin_listen(List* args)
         if(converter->type != BUILT_IN_FUNCTION) converter = NULL;
     }
 
+    Object* result;
     if (converter != NULL && strchr(buffer, ' ') != NULL) {
         List* result_list = newList(Object*);
         
@@ -134,93 +196,86 @@ Object* builtin_listen(List* args)
             add(result_list, &item);
             token = strtok(NULL, " ");
         }
-        return new_array(result_list);
+        result = obj_pack(new_array(result_list));
     } else if(converter != NULL) {
-        Object* result = new_string(buffer);
+        result = new_string(buffer);
         List* tmp_args = newList(Object*);
         add(tmp_args, &result);
         result = converter->b_func(tmp_args);
         dList(tmp_args);
-        return result;
     } else {
-        return new_string(buffer);
+        result = new_string(buffer);
     }
+    free(buffer);
+    return result;
 }
 
 /**
- * 整数のリストを返す関数です。
- * 引数が1つの場合は0から引数の数まで1ずつ数えた数値のリストを返します。
- * 引数が2つの場合は第1引数から第2引数まで1つずつ数え上げた数値のリストを返します。
- * 引数が3つの場合は第1引数から第2引数まで第3引数の間隔で数え上げた数値のリストを変えします。
- * 第3引数が0だった場合は強制的に1として実行されます。
+ * rangeの引数から開始・終了・間隔を求めます。
+ * 引数が整数でない場合は偽を返します。
+ * 間隔が0だった場合は強制的に1とします。
  */
-Object* builtin_range(List* args)
+static bool range_arguments(List* args, long* start, long* end, long* step)
 {
-    if(args == NULL || getSize(args) < 1) {
-        return new_array(newList(Object*));
-    }
+    *start = 0;
+    *end = 0;
+    *step = 1;
+    if(args == NULL || getSize(args) < 1) return true;
 
-    long start = 0;
-    long end = 0;
-    long step = 1;
+    int size = getSize(args);
+    Object* values[3] = { NULL, NULL, NULL };
+    for(int index = 0; index < size && index < 3; index++) {
+        getAt(args, index, Object*, &values[index]);
+        if(values[index]->type != INTEGER) return false;
+    }
 
-    if(getSize(args) == 1) {
-        Object* arg;
-        getAt(args, 0, Object*, &arg);
-        if (arg->type != INTEGER) {
-            fprintf(stderr, "Runtime Error: range requires integer arguments.\n");
-            return new_array(newList(Object*));
-        }
-        end = arg->integer;
-    } else if(getSize(args) == 2) {
-        Object *start_obj, *end_obj;
-        getAt(args, 0, Object*, &start_obj);
-        getAt(args, 1, Object*, &end_obj);
-    
-        if (start_obj->type != INTEGER || end_obj->type != INTEGER) {
-            fprintf(stderr, "Runtime Error: range requires integer arguments.\n");
-            return new_array(newList(Object*));
-        }
-    
-        start = start_obj->integer;
-        end = end_obj->integer;
-    } else if(getSize(args) == 3) {
-        Object *start_obj, *end_obj, *step_obj;
-        getAt(args, 0, Object*, &start_obj);
-        getAt(args, 1, Object*, &end_obj);
-        getAt(args, 2, Object*, &step_obj);
-    
-        if (start_obj->type != INTEGER || end_obj->type != INTEGER || step_obj->type != INTEGER) {
-            fprintf(stderr, "Runtime Error: range requires integer arguments.\n");
-            return new_array(newList(Object*));
-        }
-    
-        start = start_obj->integer;
-        end = end_obj->integer;
-        step = step_obj->integer;
+    if(size == 1) {
+        *end = values[0]->integer;
+    } else if(size == 2) {
+        *start = values[0]->integer;
+        *end = values[1]->integer;
+    } else if(size == 3) {
+        *start = values[0]->integer;
+        *end = values[1]->integer;
+        *step = values[2]->integer;
     }
 
-    if(step == 0) step = 1;
+    if(*step == 0) *step = 1;
+    return true;
+}
 
-    List* result = newList(Object*);
+/**
+ * 開始から終了まで間隔ごとに数え上げたときの個数を返します。
+ */
+static unsigned long range_count(long start, long end, long step)
+{
+    if(step > 0)
+        return (start < end) ? ((unsigned long)end - (unsigned long)start - 1) / (unsigned long)step + 1 : 0;
+    return (start > end) ? ((unsigned long)start - (unsigned long)end - 1) / (0UL - (unsigned long)step) + 1 : 0;
+}
 
-    if(step > 0) {
-        for(long index = start; index < end; index += step) {
-            Object* value = new_int(index);
-            add(result, &value);
-        }
-    } else {
-        for(long index = start; index > end; index += step) {
-            Object* value = new_int(index);
-            add(result, &value);
-        }
+/**
+ * 整数の等差数列を返す関数です。
+ * 引数が1つの場合は0から引数の数まで1ずつ数えた数列を返します。
+ * 引数が2つの場合は第1引数から第2引数まで1つずつ数え上げた数列を返します。
+ * 引数が3つの場合は第1引数から第2引数まで第3引数の間隔で数え上げた数列を返します。
+ * 第3引数が0だった場合は強制的に1として実行されます。
+ * 数列はリストとして変更されるまで要素を作成しません。
+ */
+Object* builtin_range(List* args)
+{
+    long start, end, step;
+    if(!range_arguments(args, &start, &end, &step)) {
+        fprintf(stderr, "Runtime Error: range requires integer arguments.\n");
+        return new_array(newList(Object*));
     }
 
-    return new_array(result);
+    return new_range(start, step, (long)range_count(start, end, step));
 }
 
 /**
  * 受け取ったリストの長さを返します。
+ * 両端キューやマップ、集合、ヒープを受け取った場合は要素の数を、結果を記録する関数を受け取った場合は、記録している結果の数を返します。
  */
 Object* builtin_len(List* args)
 {
@@ -233,8 +288,24 @@ Object* builtin_len(List* args)
         getAt(args, 0, Object*, &arg);
         if(arg->type == LIST)
             return new_int((long) getSize(arg->list));
+        if(arg->type == RANGE)
+            return new_int(arg->range->length);
+        if(is_typed_array(arg))
+            return new_int(arg->array->length);
+        if(arg->type == SEQUENCE)
+            return new_int(sequence_length(arg));
         if(arg->type == STRING)
             return new_int((long) strlen(arg->string));
+        if(arg->type == MAP)
+            return new_int((long) arg->map->count);
+        if(arg->type == SET)
+            return new_int((long) arg->set->count);
+        if(arg->type == DEQUE)
+            return new_int((long) arg->deque->count);
+        if(arg->type == HEAP)
+            return new_int((long) heap_size(arg->heap));
+        if(arg->type == FUNCTION && arg->func->memo != NULL)
+            return new_int((long) arg->func->memo->count);
 
     }
     return new_int((long)size);
@@ -242,44 +313,70 @@ Object* builtin_len(List* args)
 
 /**
  * 第1引数に受け取った配列の末尾に第2引数の要素を追加します。
+ * 両端キューや型付き配列を受け取った場合は、その末尾に追加して同じオブジェクトを返します。
+ * 型付き配列と型の違う値を追加した場合は、配列をリストに変換してから追加します。
  */
 Object* builtin_push(List* args)
 {
     if(args == NULL || getSize(args) < 2) {
-        fprintf(stderr, "Runtime Error: append requires at least 2 arguments.\n");
-        exit(EXIT_FAILURE);
+        output_error("Runtime Error: append requires at least 2 arguments.\n");
     }
 
     Object *list, *value;
     getAt(args, 0, Object*, &list);
     getAt(args, 1, Object*, &value);
 
-    if(list->type != LIST) {
-        fprintf(stderr, "Runtime Error: first argument requires list.\n");
-        exit(EXIT_FAILURE);
+    if(list->type == DEQUE) {
+        invalidate_caches();
+        deque_push_back(list->deque, value);
+        return list;
+    }
+    if(list->type != LIST && list->type != RANGE && list->type != SEQUENCE && !is_typed_array(list)) {
+        output_error("Runtime Error: first argument requires list.\n");
     }
+    obj_prepare_store(list, value);
+    invalidate_caches();
 
+    if(list->type == INT_ARRAY) {
+        typed_array_push_integer(list->array, value->integer);
+        return list;
+    }
+    if(list->type == FLOAT_ARRAY) {
+        typed_array_push_real(list->array, value->real);
+        return list;
+    }
     add(list->list, &value);
 
     return new_array(list->list);
 }
 
 /**
- * 第1引数の配列の最後の要素を削除し、返します。
+ * 第1引数の配列や両端キューの最後の要素を削除し、返します。
  */
 Object* builtin_pop(List* args)
 {
     if(args == NULL || getSize(args) < 1) {
-        fprintf(stderr, "Runtime Error: push requires at least 1 arguments.\n");
-        exit(EXIT_FAILURE);
+        output_error("Runtime Error: push requires at least 1 arguments.\n");
     }
 
     Object* list;
     getAt(args, 0, Object*, &list);
 
-    if(list->type != LIST) {
-        fprintf(stderr, "Runtime Error: pop requires list.\n");
-        exit(EXIT_FAILURE);
+    if(list->type == DEQUE) {
+        invalidate_caches();
+        Object* last = deque_pop_back(list->deque);
+        return (last == NULL) ? new_int(0) : last;
+    }
+    if(list->type != LIST && list->type != RANGE && list->type != SEQUENCE && !is_typed_array(list)) {
+        output_error("Runtime Error: pop requires list.\n");
+    }
+    obj_prepare_store(list, NULL);
+    invalidate_caches();
+    if(is_typed_array(list)) {
+        if(list->array->length == 0) return new_int(0);
+        Object* last = typed_at(list, list->array->length - 1);
+        list->array->length--;
+        return last;
     }
     int size = getSize(list->list);
     if(size == 0) return new_int(0);
@@ -289,3 +386,734 @@ Object* builtin_pop(List* args)
     removeAt(list->list, size-1);
     return last;
 }
+
+/**
+ * map、filter、reduceの引数から関数と列を取り出します。
+ * 引数が足りない場合や型が違う場合はエラーとします。
+ */
+static void pipeline_arguments(List* args, const char* name, Object** function, Object** source)
+{
+    if(args == NULL || getSize(args) < 2) {
+        output_error("Runtime Error: %s requires a function and a list.\n", name);
+    }
+    getAt(args, 0, Object*, function);
+    getAt(args, 1, Object*, source);
+
+    if((*function)->type != FUNCTION && (*function)->type != BUILT_IN_FUNCTION && (*function)->type != RECORD_TYPE) {
+        output_error("Runtime Error: first argument of %s requires function.\n", name);
+    }
+    if(!is_iterable(*source)) {
+        output_error("Runtime Error: second argument of %s requires list.\n", name);
+    }
+}
+
+/**
+ * 第2引数の列の各要素に第1引数の関数を適用した列を返します。
+ * 値は取り出されるまで計算されません。
+ */
+Object* builtin_map(List* args)
+{
+    Object *function, *source;
+    pipeline_arguments(args, "map", &function, &source);
+    return new_sequence(newSequence(SEQUENCE_MAP, function, source, 0));
+}
+
+/**
+ * 第2引数の列のうち第1引数の関数が真を返す要素だけの列を返します。
+ * 値は取り出されるまで計算されません。
+ */
+Object* builtin_filter(List* args)
+{
+    Object *function, *source;
+    pipeline_arguments(args, "filter", &function, &source);
+    return new_sequence(newSequence(SEQUENCE_FILTER, function, source, 0));
+}
+
+/**
+ * 第2引数の列の要素を第1引数の関数で左から順に畳み込みます。
+ * 第3引数があればそれを初期値とし、なければ最初の要素を初期値とします。
+ * 空の列で初期値もない場合は0を返します。
+ */
+Object* builtin_reduce(List* args)
+{
+    Object *function, *source;
+    pipeline_arguments(args, "reduce", &function, &source);
+
+    Iterator* iterator = newIterator(source);
+    Object* accumulator = NULL;
+    if(getSize(args) >= 3)
+        getAt(args, 2, Object*, &accumulator);
+    else if(has_next(iterator))
+        accumulator = next(iterator);
+    else
+        accumulator = new_int(0);
+
+    List* pair = newList(Object*);
+    add(pair, &accumulator);
+    add(pair, &accumulator);
+    while(has_next(iterator)) {
+        Object* value = next(iterator);
+        setAt(pair, 0, Object*, &accumulator);
+        setAt(pair, 1, Object*, &value);
+        accumulator = call_object(function, pair);
+    }
+    dList(pair);
+    dIterator(iterator);
+    return accumulator;
+}
+
+/**
+ * 第2引数の列の先頭から第1引数の個数だけ取り出す列を返します。
+ * 値は取り出されるまで計算されません。
+ */
+Object* builtin_take(List* args)
+{
+    if(args == NULL || getSize(args) < 2) {
+        output_error("Runtime Error: take requires a count and a list.\n");
+    }
+    Object *count, *source;
+    getAt(args, 0, Object*, &count);
+    getAt(args, 1, Object*, &source);
+
+    if(count->type != INTEGER) {
+        output_error("Runtime Error: first argument of take requires integer.\n");
+    }
+    if(!is_iterable(source)) {
+        output_error("Runtime Error: second argument of take requires list.\n");
+    }
+    return new_sequence(newSequence(SEQUENCE_TAKE, NULL, source, count->integer < 0 ? 0 : count->integer));
+}
+
+/**
+ * 空のマップを返します。
+ */
+Object* builtin_dict(List* args)
+{
+    (void)args;
+    return new_map(newMap());
+}
+
+/**
+ * マップまたは集合と、キーの引数を取り出します。
+ * 引数が足りない場合や型が違う場合はエラーとします。
+ */
+static void key_arguments(List* args, const char* name, Object** container, Object** key)
+{
+    if(args == NULL || getSize(args) < 2) {
+        output_error("Runtime Error: %s requires a map or a set and a key.\n", name);
+    }
+    getAt(args, 0, Object*, container);
+    getAt(args, 1, Object*, key);
+
+    if((*container)->type != MAP && (*container)->type != SET) {
+        output_error("Runtime Error: first argument of %s requires map or set.\n", name);
+    }
+    if(!map_is_key(*key)) {
+        output_error("Runtime Error: map key must be a string or a number.\n");
+    }
+}
+
+/**
+ * 第1引数のマップや集合に第2引数のキーがあるかどうかを返します。
+ */
+Object* builtin_has(List* args)
+{
+    Object *container, *key;
+    key_arguments(args, "has", &container, &key);
+    if(container->type == SET) return new_bool(set_has(container->set, key));
+    return new_bool(map_get(container->map, key) != NULL);
+}
+
+/**
+ * マップのキーを追加した順に並べたリストを返します。
+ */
+Object* builtin_keys(List* args)
+{
+    Object* map = NULL;
+    if(args != NULL && getSize(args) >= 1) getAt(args, 0, Object*, &map);
+    if(map == NULL || map->type != MAP) {
+        output_error("Runtime Error: keys requires map.\n");
+    }
+    return new_array(map_keys(map->map));
+}
+
+/**
+ * 第1引数のマップや集合から第2引数のキーを削除し、削除したかどうかを返します。
+ */
+Object* builtin_remove(List* args)
+{
+    Object *container, *key;
+    key_arguments(args, "remove", &container, &key);
+    invalidate_caches();
+    if(container->type == SET) return new_bool(set_remove(container->set, key));
+    return new_bool(map_remove(container->map, key));
+}
+
+/**
+ * 集合に値を加えます。集合にできない値の場合はエラーとします。
+ */
+static void add_element(Set* set, Object* value)
+{
+    if(!map_is_key(value)) {
+        output_error("Runtime Error: set element must be a string or a number.\n");
+    }
+    set_add(set, value);
+}
+
+/**
+ * 引数の値の集合を返します。
+ * 引数がリストなどの列1つの場合は、その要素の集合を返します。
+ */
+Object* builtin_set(List* args)
+{
+    Set* set = newSet();
+    int size = (args == NULL) ? 0 : getSize(args);
+    Object* first = NULL;
+    if(size == 1) getAt(args, 0, Object*, &first);
+
+    if(first != NULL && is_iterable(first)) {
+        Iterator* iterator = newIterator(first);
+        while(has_next(iterator)) add_element(set, next(iterator));
+        dIterator(iterator);
+    } else {
+        for(int index = 0; index < size; index++) {
+            Object* value;
+            getAt(args, index, Object*, &value);
+            add_element(set, value);
+        }
+    }
+    return new_set(set);
+}
+
+/**
+ * 第1引数の集合に第2引数の値を加え、新しく加えたかどうかを返します。
+ */
+Object* builtin_add(List* args)
+{
+    Object *container, *value;
+    key_arguments(args, "add", &container, &value);
+    if(container->type != SET) {
+        output_error("Runtime Error: first argument of add requires set.\n");
+    }
+    invalidate_caches();
+    return new_bool(set_add(container->set, value));
+}
+
+/**
+ * 集合の演算の2つの引数を取り出します。
+ * 引数が足りない場合や型が違う場合はエラーとします。
+ */
+static void set_arguments(List* args, const char* name, Set** left, Set** right)
+{
+    Object *first = NULL, *second = NULL;
+    if(args != NULL && getSize(args) >= 2) {
+        getAt(args, 0, Object*, &first);
+        getAt(args, 1, Object*, &second);
+    }
+    if(first == NULL || second == NULL || first->type != SET || second->type != SET) {
+        output_error("Runtime Error: %s requires two sets.\n", name);
+    }
+    *left = first->set;
+    *right = second->set;
+}
+
+/**
+ * 2つの集合の和集合を返します。
+ */
+Object* builtin_union(List* args)
+{
+    Set *left, *right;
+    set_arguments(args, "union", &left, &right);
+    return new_set(set_union(left, right));
+}
+
+/**
+ * 2つの集合の積集合を返します。
+ */
+Object* builtin_intersection(List* args)
+{
+    Set *left, *right;
+    set_arguments(args, "intersection", &left, &right);
+    return new_set(set_intersection(left, right));
+}
+
+/**
+ * 第1引数の集合から第2引数の集合の要素を除いた差集合を返します。
+ */
+Object* builtin_difference(List* args)
+{
+    Set *left, *right;
+    set_arguments(args, "difference", &left, &right);
+    return new_set(set_difference(left, right));
+}
+
+/**
+ * 空のヒープを返します。
+ * 引数に関数を受け取った場合は、追加する値にその関数を適用した結果を比べるキーとします。
+ */
+Object* builtin_heap(List* args)
+{
+    Object* key_function = NULL;
+    if(args != NULL && getSize(args) >= 1) {
+        getAt(args, 0, Object*, &key_function);
+        if(key_function->type != FUNCTION && key_function->type != BUILT_IN_FUNCTION) {
+            output_error("Runtime Error: argument of heap requires function.\n");
+        }
+    }
+    return new_heap(newHeap(key_function));
+}
+
+/**
+ * 第1引数のヒープを取り出します。
+ * 引数が足りない場合や型が違う場合はエラーとします。
+ */
+static Heap* heap_argument(List* args, const char* name, int count)
+{
+    Object* heap = NULL;
+    if(args != NULL && getSize(args) >= count) getAt(args, 0, Object*, &heap);
+    if(heap == NULL || heap->type != HEAP) {
+        output_error("Runtime Error: %s requires a heap%s.\n", name, (count > 1) ? " and a value" : "");
+    }
+    return heap->heap;
+}
+
+/**
+ * 第1引数のヒープに第2引数の値を追加します。
+ * キーを求める関数は、追加するときに1回だけ呼び出します。
+ */
+Object* builtin_heap_push(List* args)
+{
+    Heap* heap = heap_argument(args, "heap_push", 2);
+    Object* value;
+    getAt(args, 1, Object*, &value);
+
+    Object* key = value;
+    if(heap->key_function != NULL) {
+        List* key_args = newList(Object*);
+        add(key_args, &value);
+        key = call_object(heap->key_function, key_args);
+        dList(key_args);
+    }
+    if(!heap_is_key(key)) {
+        output_error("Runtime Error: heap key must be a number, a string or a list of them.\n");
+    }
+    invalidate_caches();
+    heap_push(heap, key, value);
+    return value;
+}
+
+/**
+ * 第1引数のヒープから最も小さいキーの値を取り除いて返します。
+ * 空のヒープの場合はエラーとします。
+ */
+Object* builtin_heap_pop(List* args)
+{
+    Heap* heap = heap_argument(args, "heap_pop", 1);
+    invalidate_caches();
+    Object* value = heap_pop(heap);
+    if(value == NULL) {
+        output_error("Runtime Error: heap_pop from an empty heap.\n");
+    }
+    return value;
+}
+
+/**
+ * 第1引数のヒープで最も小さいキーの値を、取り除かずに返します。
+ * 空のヒープの場合はエラーとします。
+ */
+Object* builtin_heap_peek(List* args)
+{
+    Heap* heap = heap_argument(args, "heap_peek", 1);
+    Object* value = heap_peek(heap);
+    if(value == NULL) {
+        output_error("Runtime Error: heap_peek from an empty heap.\n");
+    }
+    return value;
+}
+
+/**
+ * 引数の値を並べた両端キューを返します。
+ * 引数がリストなどの列1つの場合は、その要素を並べた両端キューを返します。
+ */
+Object* builtin_deque(List* args)
+{
+    Deque* deque = newDeque();
+    int size = (args == NULL) ? 0 : getSize(args);
+    Object* first = NULL;
+    if(size == 1) getAt(args, 0, Object*, &first);
+
+    if(first != NULL && is_iterable(first)) {
+        Iterator* iterator = newIterator(first);
+        while(has_next(iterator)) deque_push_back(deque, next(iterator));
+        dIterator(iterator);
+    } else {
+        for(int index = 0; index < size; index++) {
+            Object* value;
+            getAt(args, index, Object*, &value);
+            deque_push_back(deque, value);
+        }
+    }
+    return new_deque(deque);
+}
+
+/**
+ * 第1引数の両端キューの先頭に第2引数の値を追加し、両端キューを返します。
+ */
+Object* builtin_push_front(List* args)
+{
+    Object *deque = NULL, *value = NULL;
+    if(args != NULL && getSize(args) >= 2) {
+        getAt(args, 0, Object*, &deque);
+        getAt(args, 1, Object*, &value);
+    }
+    if(deque == NULL || deque->type != DEQUE) {
+        output_error("Runtime Error: push_front requires a deque and a value.\n");
+    }
+    invalidate_caches();
+    deque_push_front(deque->deque, value);
+    return deque;
+}
+
+/**
+ * 第1引数の両端キューの先頭の要素を削除し、返します。
+ */
+Object* builtin_pop_front(List* args)
+{
+    Object* deque = NULL;
+    if(args != NULL && getSize(args) >= 1) getAt(args, 0, Object*, &deque);
+    if(deque == NULL || deque->type != DEQUE) {
+        output_error("Runtime Error: pop_front requires a deque.\n");
+    }
+    invalidate_caches();
+    Object* first = deque_pop_front(deque->deque);
+    return (first == NULL) ? new_int(0) : first;
+}
+
+/**
+ * 型付き配列の末尾に数値を追加します。
+ * 整数の配列では実数を整数に、実数の配列では整数を実数に変換します。
+ */
+static void push_number(Object* array, Object* value, const char* name)
+{
+    if(value == NULL || (value->type != INTEGER && value->type != FLOAT)) {
+        output_error("Runtime Error: %s requires numbers.\n", name);
+    }
+    if(array->type == INT_ARRAY)
+        typed_array_push_integer(array->array, (value->type == INTEGER) ? value->integer : (long)value->real);
+    else
+        typed_array_push_real(array->array, (value->type == FLOAT) ? value->real : (double)value->integer);
+}
+
+/**
+ * int_arrayとfloat_arrayの本体です。
+ * 引数の値を並べた型付き配列を返します。引数がリストなどの列1つの場合は、その要素を並べます。
+ */
+static Object* make_typed_array(List* args, ObjectType type, const char* name)
+{
+    int size = (args == NULL) ? 0 : getSize(args);
+    Object* array = (type == INT_ARRAY) ? new_int_array(newTypedArray(size)) : new_float_array(newTypedArray(size));
+    Object* first = NULL;
+    if(size == 1) getAt(args, 0, Object*, &first);
+
+    if(first != NULL && is_iterable(first)) {
+        Iterator* iterator = newIterator(first);
+        while(has_next(iterator)) push_number(array, next(iterator), name);
+        dIterator(iterator);
+    } else {
+        for(int index = 0; index < size; index++) {
+            Object* value;
+            getAt(args, index, Object*, &value);
+            push_number(array, value, name);
+        }
+    }
+    return array;
+}
+
+/**
+ * 引数の値を並べた整数の型付き配列を返します。
+ */
+Object* builtin_int_array(List* args)
+{
+    return make_typed_array(args, INT_ARRAY, "int_array");
+}
+
+/**
+ * 引数の値を並べた実数の型付き配列を返します。
+ */
+Object* builtin_float_array(List* args)
+{
+    return make_typed_array(args, FLOAT_ARRAY, "float_array");
+}
+
+/**
+ * 値を集計できる数値の列にします。
+ * 型付き配列、等差数列、リストはそのまま返し、それ以外の列は値を取り出してリストにします。
+ */
+static Object* numbers_of(Object* value)
+{
+    if(value->type == LIST || value->type == RANGE || is_typed_array(value)) return value;
+    List* values = newList(Object*);
+    Iterator* iterator = newIterator(value);
+    while(has_next(iterator)) {
+        Object* item = next(iterator);
+        add(values, &item);
+    }
+    dIterator(iterator);
+    return new_array(values);
+}
+
+/**
+ * 集計する関数の引数から数値の列を取り出します。
+ * 引数がリストなどの列1つの場合はその列を、それ以外の場合は引数を並べた列を返します。
+ */
+static Object* numbers_argument(List* args)
+{
+    int size = (args == NULL) ? 0 : getSize(args);
+    Object* first = NULL;
+    if(size == 1) getAt(args, 0, Object*, &first);
+    if(first != NULL && is_iterable(first)) return numbers_of(first);
+    return new_array((args == NULL) ? newList(Object*) : args);
+}
+
+/**
+ * 数値の列の長さを返します。
+ */
+static long numbers_length(Object* numbers)
+{
+    if(numbers->type == RANGE) return numbers->range->length;
+    if(is_typed_array(numbers)) return numbers->array->length;
+    return getSize(numbers->list);
+}
+
+/**
+ * 数値の列のindex番目の値を取り出し、実数であるかどうかを返します。
+ * 整数であればintegerに、実数であればrealに設定し、数値でなければエラーとします。
+ */
+static bool number_at(Object* numbers, long index, long* integer, double* real, const char* name)
+{
+    switch(numbers->type) {
+        case INT_ARRAY:
+            *integer = numbers->array->integers[index];
+            return false;
+        case FLOAT_ARRAY:
+            *real = numbers->array->reals[index];
+            return true;
+        case RANGE:
+            *integer = range_at(numbers->range, index);
+            return false;
+        default: {
+            Object* value;
+            getAt(numbers->list, (int)index, Object*, &value);
+            if(value != NULL && value->type == INTEGER) {
+                *integer = value->integer;
+                return false;
+            }
+            if(value != NULL && value->type == FLOAT) {
+                *real = value->real;
+                return true;
+            }
+            output_error("Runtime Error: %s requires numbers.\n", name);
+        }
+    }
+}
+
+/**
+ * 数値の列の要素の和を求め、実数であるかどうかを返します。
+ * 整数だけの和はintegerに、実数を含む和はrealに設定します。
+ * 等差数列は要素を取り出さずに公式から求めます。
+ */
+static bool total_of(Object* numbers, long* integer, double* real, const char* name)
+{
+    if(numbers->type == INT_ARRAY) {
+        *integer = typed_array_sum_integers(numbers->array);
+        return false;
+    }
+    if(numbers->type == FLOAT_ARRAY) {
+        *real = typed_array_sum_reals(numbers->array);
+        return true;
+    }
+    if(numbers->type == RANGE) {
+        Range* range = numbers->range;
+        unsigned long length = (unsigned long)range->length;
+        unsigned long pairs = (length % 2 == 0) ? (length / 2) * (length - 1) : length * ((length - 1) / 2);
+        *integer = (long)(length * (unsigned long)range->start + pairs * (unsigned long)range->step);
+        return false;
+    }
+
+    unsigned long integer_total = 0;
+    double real_total = 0;
+    bool has_real = false;
+    long length = numbers_length(numbers);
+    for(long index = 0; index < length; index++) {
+        long integer_value;
+        double real_value;
+        if(number_at(numbers, index, &integer_value, &real_value, name)) {
+            real_total += real_value;
+            has_real = true;
+        } else {
+            integer_total += (unsigned long)integer_value;
+        }
+    }
+    if(has_real) *real = (double)(long)integer_total + real_total;
+    else *integer = (long)integer_total;
+    return has_real;
+}
+
+/**
+ * 数値の列の要素の和を返します。
+ * 全て整数であれば整数を、実数を含む場合は実数を返します。
+ */
+Object* builtin_sum(List* args)
+{
+    long integer;
+    double real;
+    if(total_of(numbers_argument(args), &integer, &real, "sum")) return new_float(real);
+    return new_int(integer);
+}
+
+/**
+ * 数値の列の要素の平均を実数で返します。
+ */
+Object* builtin_mean(List* args)
+{
+    Object* numbers = numbers_argument(args);
+    long length = numbers_length(numbers);
+    if(length == 0) {
+        output_error("Runtime Error: mean requires at least 1 number.\n");
+    }
+    if(numbers->type == RANGE)
+        return new_float((double)numbers->range->start + (double)numbers->range->step * (double)(length - 1) / 2.0);
+
+    long integer;
+    double real;
+    if(total_of(numbers, &integer, &real, "mean")) return new_float(real / (double)length);
+    return new_float((double)integer / (double)length);
+}
+
+/**
+ * 空でない数値の列で、最も大きい(is_maxが偽の場合は最も小さい)要素のうち最初のものの位置を返します。
+ */
+static long extreme_index(Object* numbers, bool is_max, const char* name)
+{
+    long length = numbers_length(numbers);
+    if(length == 0) {
+        output_error("Runtime Error: %s requires at least 1 number.\n", name);
+    }
+    if(numbers->type == INT_ARRAY) return typed_array_extreme_integers(numbers->array, is_max);
+    if(numbers->type == FLOAT_ARRAY) return typed_array_extreme_reals(numbers->array, is_max);
+    if(numbers->type == RANGE) return ((numbers->range->step > 0) == is_max) ? length - 1 : 0;
+
+    long best = 0, best_integer = 0;
+    double best_real = 0;
+    bool best_is_real = number_at(numbers, 0, &best_integer, &best_real, name);
+    for(long index = 1; index < length; index++) {
+        long integer;
+        double real;
+        bool is_real = number_at(numbers, index, &integer, &real, name);
+        bool is_better;
+        if(!is_real && !best_is_real) {
+            is_better = is_max ? (integer > best_integer) : (integer < best_integer);
+        } else {
+            double value = is_real ? real : (double)integer;
+            double best_value = best_is_real ? best_real : (double)best_integer;
+            is_better = is_max ? (value > best_value) : (value < best_value);
+        }
+        if(is_better) {
+            best = index;
+            best_integer = integer;
+            best_real = real;
+            best_is_real = is_real;
+        }
+    }
+    return best;
+}
+
+/**
+ * 数値の列のindex番目の要素を返します。
+ */
+static Object* number_object(Object* numbers, long index, const char* name)
+{
+    long integer;
+    double real;
+    if(number_at(numbers, index, &integer, &real, name)) return new_float(real);
+    return new_int(integer);
+}
+
+/**
+ * 数値の列の最も小さい要素を返します。
+ */
+Object* builtin_min(List* args)
+{
+    Object* numbers = numbers_argument(args);
+    return number_object(numbers, extreme_index(numbers, false, "min"), "min");
+}
+
+/**
+ * 数値の列の最も大きい要素を返します。
+ */
+Object* builtin_max(List* args)
+{
+    Object* numbers = numbers_argument(args);
+    return number_object(numbers, extreme_index(numbers, true, "max"), "max");
+}
+
+/**
+ * 数値の列の最も小さい要素の位置を返します。同じ値が複数ある場合は最初の位置を返します。
+ */
+Object* builtin_argmin(List* args)
+{
+    return new_int(extreme_index(numbers_argument(args), false, "argmin"));
+}
+
+/**
+ * 数値の列の最も大きい要素の位置を返します。同じ値が複数ある場合は最初の位置を返します。
+ */
+Object* builtin_argmax(List* args)
+{
+    return new_int(extreme_index(numbers_argument(args), true, "argmax"));
+}
+
+/**
+ * 同じ長さの2つの数値の列の内積を返します。
+ * 全て整数であれば整数を、実数を含む場合は実数を返します。
+ */
+Object* builtin_dot(List* args)
+{
+    Object *left = NULL, *right = NULL;
+    if(args != NULL && getSize(args) == 2) {
+        getAt(args, 0, Object*, &left);
+        getAt(args, 1, Object*, &right);
+    }
+    if(left == NULL || right == NULL || !is_iterable(left) || !is_iterable(right)) {
+        output_error("Runtime Error: dot requires 2 lists.\n");
+    }
+    left = numbers_of(left);
+    right = numbers_of(right);
+    long length = numbers_length(left);
+    if(numbers_length(right) != length) {
+        output_error("Runtime Error: dot requires lists of the same length.\n");
+    }
+    if(left->type == INT_ARRAY && right->type == INT_ARRAY)
+        return new_int(typed_array_dot_integers(left->array, right->array));
+    if(left->type == FLOAT_ARRAY && right->type == FLOAT_ARRAY)
+        return new_float(typed_array_dot_reals(left->array, right->array));
+
+    unsigned long integer_total = 0;
+    double real_total = 0;
+    bool has_real = false;
+    for(long index = 0; index < length; index++) {
+        long left_integer, right_integer;
+        double left_real, right_real;
+        bool left_is_real = number_at(left, index, &left_integer, &left_real, "dot");
+        bool right_is_real = number_at(right, index, &right_integer, &right_real, "dot");
+        if(!left_is_real && !right_is_real) {
+            integer_total += (unsigned long)left_integer * (unsigned long)right_integer;
+        } else {
+            real_total += (left_is_real ? left_real : (double)left_integer) *
+                            (right_is_real ? right_real : (double)right_integer);
+            has_real = true;
+        }
+    }
+    if(has_real) return new_float((double)(long)integer_total + real_total);
+    return new_int((long)integer_total);
+}